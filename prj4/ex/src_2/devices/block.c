@@ -4,6 +4,10 @@
 #include <stdio.h>
 #include "devices/ide.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* Most sectors that queued requests are merged into. */
+#define BLOCK_MERGE_MAX 64
 
 /* A block device. */
 struct block
@@ -17,8 +21,16 @@ struct block
     const struct block_operations *ops;  /* Driver operations. */
     void *aux;                          /* Extra data owned by driver. */
 
-    unsigned long long read_cnt;        /* Number of sectors read. */
-    unsigned long long write_cnt;       /* Number of sectors written. */
+    struct block_stats stats;           /* Statistics.  The queue members
+                                           are protected by queue_lock. */
+    block_sector_t next_sector;         /* Sector after the last transfer. */
+
+    /* Asynchronous requests. */
+    struct lock queue_lock;             /* Protects the members below. */
+    struct list queue;                  /* Pending requests, by sector. */
+    struct semaphore queue_cnt;         /* Number of pending requests. */
+    bool worker_started;                /* Device thread created? */
+    block_sector_t head;                /* Sector after the last transfer. */
   };
 
 /* List of all block devices. */
@@ -28,6 +40,13 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+static thread_func block_worker;
+static uint64_t read_cycles (void);
+static void account_transfer (struct block *, bool write,
+                              block_sector_t, size_t cnt, uint64_t start);
+static void add_latency (uint64_t hist[BLOCK_LAT_BUCKETS], uint64_t cycles);
+static void print_histogram (const char *label,
+                             const uint64_t hist[BLOCK_LAT_BUCKETS]);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -120,9 +139,12 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
+  uint64_t start;
+
   check_sector (block, sector);
+  start = read_cycles ();
   block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  account_transfer (block, false, sector, 1, start);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +155,273 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
+  uint64_t start;
+
   check_sector (block, sector);
   ASSERT (block->type != BLOCK_FOREIGN);
+  start = read_cycles ();
   block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  account_transfer (block, true, sector, 1, start);
+}
+
+/* Reads the CNT sectors starting at SECTOR from BLOCK into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE bytes.
+   Uses a single device command if the driver supports it.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                     void *buffer)
+{
+  uint8_t *p = buffer;
+  uint64_t start;
+  size_t i;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  start = read_cycles ();
+  if (block->ops->read_multiple != NULL)
+    block->ops->read_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->read (block->aux, sector + i, p + i * BLOCK_SECTOR_SIZE);
+  account_transfer (block, false, sector, cnt, start);
+}
+
+/* Writes the CNT sectors starting at SECTOR to BLOCK from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes.  Returns
+   after the block device has acknowledged receiving the data.
+   Uses a single device command if the driver supports it.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                      const void *buffer)
+{
+  const uint8_t *p = buffer;
+  uint64_t start;
+  size_t i;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  ASSERT (block->type != BLOCK_FOREIGN);
+  start = read_cycles ();
+  if (block->ops->write_multiple != NULL)
+    block->ops->write_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->write (block->aux, sector + i, p + i * BLOCK_SECTOR_SIZE);
+  account_transfer (block, true, sector, cnt, start);
+}
+
+/* Initializes R as a request to read, or write if WRITE is true,
+   the CNT sectors starting at SECTOR to or from BUFFER. */
+void
+block_request_init (struct block_request *r, bool write,
+                    block_sector_t sector, size_t cnt, void *buffer)
+{
+  ASSERT (cnt > 0);
+
+  r->write = write;
+  r->sector = sector;
+  r->cnt = cnt;
+  r->buffer = buffer;
+  r->complete = NULL;
+  r->aux = NULL;
+  sema_init (&r->done, 0);
+}
+
+/* Returns true if request A's sector is less than B's. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED)
+{
+  const struct block_request *a = list_entry (a_, struct block_request, elem);
+  const struct block_request *b = list_entry (b_, struct block_request, elem);
+
+  return a->sector < b->sector;
+}
+
+/* Queues request R, initialized with block_request_init(), on
+   BLOCK and returns without waiting for it.  R and its buffer
+   must stay valid until it completes. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  check_sector (block, r->sector);
+  check_sector (block, r->sector + r->cnt - 1);
+  ASSERT (!r->write || block->type != BLOCK_FOREIGN);
+
+  lock_acquire (&block->queue_lock);
+  if (!block->worker_started)
+    {
+      char name[sizeof "io_" + sizeof block->name];
+
+      snprintf (name, sizeof name, "io_%s", block->name);
+      if (thread_create (name, PRI_DEFAULT, block_worker, block)
+          == (struct thread *) TID_ERROR)
+        PANIC ("%s: can't start I/O thread", block->name);
+      block->worker_started = true;
+    }
+  list_insert_ordered (&block->queue, &r->elem, request_less, NULL);
+  r->submit_time = read_cycles ();
+  block->stats.queued_cnt++;
+  block->stats.queue_depth++;
+  block->stats.queue_depth_sum += block->stats.queue_depth;
+  if (block->stats.queue_depth > block->stats.max_queue_depth)
+    block->stats.max_queue_depth = block->stats.queue_depth;
+  lock_release (&block->queue_lock);
+  sema_up (&block->queue_cnt);
+}
+
+/* Waits for request R, submitted with block_submit() without a
+   completion function, to finish. */
+void
+block_wait (struct block_request *r)
+{
+  ASSERT (r->complete == NULL);
+  sema_down (&r->done);
+}
+
+/* Moves the next requests to carry out from BLOCK's queue to
+   BATCH: the first one at or after the head position, wrapping
+   around to the lowest sector if there is none, followed by any
+   that continue it in the same direction.  Returns the number of
+   requests moved, which is at least 1. */
+static size_t
+take_batch (struct block *block, struct list *batch)
+{
+  struct list_elem *e;
+  struct block_request *r;
+  block_sector_t end;
+  size_t sector_cnt, req_cnt;
+  uint64_t now = read_cycles ();
+  bool write;
+
+  ASSERT (!list_empty (&block->queue));
+
+  for (e = list_begin (&block->queue); e != list_end (&block->queue);
+       e = list_next (e))
+    if (list_entry (e, struct block_request, elem)->sector >= block->head)
+      break;
+  if (e == list_end (&block->queue))
+    e = list_begin (&block->queue);
+
+  r = list_entry (e, struct block_request, elem);
+  write = r->write;
+  end = r->sector;
+  sector_cnt = req_cnt = 0;
+  while (e != list_end (&block->queue))
+    {
+      r = list_entry (e, struct block_request, elem);
+      if (r->write != write || r->sector != end
+          || (req_cnt > 0 && sector_cnt + r->cnt > BLOCK_MERGE_MAX))
+        break;
+      e = list_remove (e);
+      list_push_back (batch, &r->elem);
+      add_latency (block->stats.wait_hist, now - r->submit_time);
+      end += r->cnt;
+      sector_cnt += r->cnt;
+      req_cnt++;
+    }
+  block->head = end;
+  block->stats.queue_depth -= req_cnt;
+  return req_cnt;
+}
+
+/* Carries out the requests in BATCH, which cover consecutive
+   sectors of BLOCK in one direction, with a single transfer if
+   possible. */
+static void
+do_batch (struct block *block, struct list *batch)
+{
+  struct block_request *first
+    = list_entry (list_front (batch), struct block_request, elem);
+  struct list_elem *e;
+  size_t cnt = 0;
+  uint8_t *bounce = NULL;
+
+  for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+    cnt += list_entry (e, struct block_request, elem)->cnt;
+  if (cnt > first->cnt)
+    bounce = malloc (cnt * BLOCK_SECTOR_SIZE);
+
+  if (bounce == NULL)
+    {
+      /* A single request, or no memory to merge into. */
+      for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+        {
+          struct block_request *r = list_entry (e, struct block_request, elem);
+          if (r->write)
+            block_write_multiple (block, r->sector, r->cnt, r->buffer);
+          else
+            block_read_multiple (block, r->sector, r->cnt, r->buffer);
+        }
+      return;
+    }
+
+  if (first->write)
+    {
+      uint8_t *p = bounce;
+      for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+        {
+          struct block_request *r = list_entry (e, struct block_request, elem);
+          memcpy (p, r->buffer, r->cnt * BLOCK_SECTOR_SIZE);
+          p += r->cnt * BLOCK_SECTOR_SIZE;
+        }
+      block_write_multiple (block, first->sector, cnt, bounce);
+    }
+  else
+    {
+      uint8_t *p = bounce;
+      block_read_multiple (block, first->sector, cnt, bounce);
+      for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+        {
+          struct block_request *r = list_entry (e, struct block_request, elem);
+          memcpy (r->buffer, p, r->cnt * BLOCK_SECTOR_SIZE);
+          p += r->cnt * BLOCK_SECTOR_SIZE;
+        }
+    }
+  free (bounce);
+}
+
+/* Device thread for BLOCK_.  Carries out queued requests in
+   elevator order and completes them. */
+static void
+block_worker (void *block_)
+{
+  struct block *block = block_;
+
+  for (;;)
+    {
+      struct list batch;
+      size_t req_cnt;
+
+      sema_down (&block->queue_cnt);
+      list_init (&batch);
+      lock_acquire (&block->queue_lock);
+      req_cnt = take_batch (block, &batch);
+      lock_release (&block->queue_lock);
+
+      /* The semaphore counted every request in the batch. */
+      while (req_cnt-- > 1)
+        sema_down (&block->queue_cnt);
+
+      do_batch (block, &batch);
+      while (!list_empty (&batch))
+        {
+          struct block_request *r
+            = list_entry (list_pop_front (&batch), struct block_request, elem);
+          if (r->complete != NULL)
+            r->complete (r);
+          else
+            sema_up (&r->done);
+        }
+    }
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -171,13 +456,101 @@ block_print_stats (void)
       struct block *block = block_by_role[i];
       if (block != NULL)
         {
+          const struct block_stats *s = &block->stats;
+
           printf ("%s (%s): %llu reads, %llu writes\n",
                   block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
+                  s->read_cnt, s->write_cnt);
+          if (s->seq_ops + s->random_ops == 0)
+            continue;
+          printf ("  %llu read ops, %llu write ops, "
+                  "%llu sequential, %llu random\n",
+                  s->read_ops, s->write_ops, s->seq_ops, s->random_ops);
+          print_histogram ("service", s->service_hist);
+          if (s->queued_cnt > 0)
+            {
+              printf ("  %llu queued, average depth %llu, max depth %"PRIu32"\n",
+                      s->queued_cnt, s->queue_depth_sum / s->queued_cnt,
+                      s->max_queue_depth);
+              print_histogram ("queue wait", s->wait_hist);
+            }
         }
     }
 }
 
+/* Prints the non-empty buckets of latency histogram HIST, which
+   is labeled LABEL. */
+static void
+print_histogram (const char *label, const uint64_t hist[BLOCK_LAT_BUCKETS])
+{
+  int i;
+
+  printf ("  %s cycles:", label);
+  for (i = 0; i < BLOCK_LAT_BUCKETS; i++)
+    if (hist[i] > 0)
+      printf (" %s2^%d:%llu", i < BLOCK_LAT_BUCKETS - 1 ? "<" : ">=",
+              i < BLOCK_LAT_BUCKETS - 1 ? i + 11 : i + 10, hist[i]);
+  printf ("\n");
+}
+
+/* Copies BLOCK's statistics into *STATS. */
+void
+block_get_stats (struct block *block, struct block_stats *stats)
+{
+  lock_acquire (&block->queue_lock);
+  *stats = block->stats;
+  lock_release (&block->queue_lock);
+  strlcpy (stats->name, block->name, sizeof stats->name);
+  stats->type = block->type;
+}
+
+/* Returns the CPU's cycle counter. */
+static uint64_t
+read_cycles (void)
+{
+  uint64_t cycles;
+  asm volatile ("rdtsc" : "=A" (cycles));
+  return cycles;
+}
+
+/* Adds a transfer of CNT sectors at SECTOR on BLOCK, which began
+   at cycle START, to BLOCK's statistics. */
+static void
+account_transfer (struct block *block, bool write, block_sector_t sector,
+                  size_t cnt, uint64_t start)
+{
+  struct block_stats *s = &block->stats;
+
+  add_latency (s->service_hist, read_cycles () - start);
+  if (write)
+    {
+      s->write_cnt += cnt;
+      s->write_ops++;
+    }
+  else
+    {
+      s->read_cnt += cnt;
+      s->read_ops++;
+    }
+  if (sector == block->next_sector)
+    s->seq_ops++;
+  else
+    s->random_ops++;
+  block->next_sector = sector + cnt;
+}
+
+/* Counts an operation that took CYCLES cycles in histogram HIST. */
+static void
+add_latency (uint64_t hist[BLOCK_LAT_BUCKETS], uint64_t cycles)
+{
+  int i;
+
+  for (i = 0; i < BLOCK_LAT_BUCKETS - 1; i++)
+    if (cycles < (1ULL << (i + 11)))
+      break;
+  hist[i]++;
+}
+
 /* Registers a new block device with the given NAME.  If
    EXTRA_INFO is non-null, it is printed as part of a user
    message.  The block device's SIZE in sectors and its TYPE must
@@ -198,8 +571,13 @@ block_register (const char *name, enum block_type type,
   block->size = size;
   block->ops = ops;
   block->aux = aux;
-  block->read_cnt = 0;
-  block->write_cnt = 0;
+  memset (&block->stats, 0, sizeof block->stats);
+  block->next_sector = 0;
+  lock_init (&block->queue_lock);
+  list_init (&block->queue);
+  sema_init (&block->queue_cnt, 0);
+  block->worker_started = false;
+  block->head = 0;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -6,6 +6,9 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#ifdef VM
+#include "vm/pcache.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -221,6 +224,19 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
+#ifdef VM
+      /* A page mapped by some process is read from its frame,
+         which may hold writes not yet on disk. */
+      off_t cached = pcache_read (inode, buffer + bytes_read, size, offset);
+      if (cached > 0)
+        {
+          size -= cached;
+          offset += cached;
+          bytes_read += cached;
+          continue;
+        }
+#endif
+
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
           /* Read full sector directly into caller's buffer. */
@@ -282,6 +298,14 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
+#ifdef VM
+      /* Keep a frame mapping this page in step with the disk.  The
+         frame is updated first, so that writing it back, which may
+         happen at any time, never puts older data on disk after
+         this write. */
+      pcache_write (inode, buffer + bytes_written, chunk_size, offset);
+#endif
+
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
           /* Write full sector directly to disk. */
@@ -307,7 +331,6 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
           memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
           block_write (fs_device, sector_idx, bounce);
         }
-
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
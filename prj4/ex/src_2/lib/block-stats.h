@@ -0,0 +1,37 @@
+#ifndef __LIB_BLOCK_STATS_H
+#define __LIB_BLOCK_STATS_H
+
+#include <stdint.h>
+
+/* Number of buckets in a block device latency histogram.  Bucket
+   I counts operations that took fewer than 2**(I + 11) CPU
+   cycles, and more than half that for I > 0.  The last bucket
+   also counts everything slower. */
+#define BLOCK_LAT_BUCKETS 16
+
+/* Block device statistics, as returned by the block_stats system
+   call.  Shared by the kernel and user programs. */
+struct block_stats
+  {
+    char name[16];                      /* Device name, e.g. "hda2". */
+    int type;                           /* enum block_type. */
+
+    /* Transfers, each of one or more sectors. */
+    uint64_t read_cnt;                  /* Sectors read. */
+    uint64_t write_cnt;                 /* Sectors written. */
+    uint64_t read_ops;                  /* Read transfers. */
+    uint64_t write_ops;                 /* Write transfers. */
+    uint64_t seq_ops;                   /* Transfers that started where
+                                           the previous one ended. */
+    uint64_t random_ops;                /* Other transfers. */
+    uint64_t service_hist[BLOCK_LAT_BUCKETS];   /* Transfer latency. */
+
+    /* Asynchronous requests. */
+    uint64_t queued_cnt;                /* Requests submitted. */
+    uint64_t queue_depth_sum;           /* Sum of depth seen at submit. */
+    uint32_t queue_depth;               /* Requests queued now. */
+    uint32_t max_queue_depth;           /* Most requests ever queued. */
+    uint64_t wait_hist[BLOCK_LAT_BUCKETS];      /* Time spent queued. */
+  };
+
+#endif /* lib/block-stats.h */
@@ -25,6 +25,7 @@ enum
     /* Project 3 and optionally project 4. */
     SYS_MMAP,                   /* Map a file into memory. */
     SYS_MUNMAP,                 /* Remove a memory mapping. */
+    SYS_FORK,                   /* Clone this process copy-on-write. */
 
     /* Project 4 only. */
     SYS_CHDIR,                  /* Change the current directory. */
@@ -179,6 +179,12 @@ munmap (mapid_t mapid)
   syscall1 (SYS_MUNMAP, mapid);
 }
 
+pid_t
+fork (void)
+{
+  return syscall0 (SYS_FORK);
+}
+
 bool
 chdir (const char *dir)
 {
@@ -37,6 +37,7 @@ void close (int fd);
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
 void munmap (mapid_t);
+pid_t fork (void);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
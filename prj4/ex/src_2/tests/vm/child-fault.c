@@ -0,0 +1,68 @@
+/* Child process of page-fault-par.
+   Fills a large buffer page by page, so that with its siblings it
+   needs more memory than there is and evicts dirty pages to swap,
+   and in between reads a large read-only array that lives in its
+   executable, so that its faults on file-backed pages, shared
+   with its siblings through the page cache, overlap their
+   write-back.  Checks every byte of both on each pass. */
+
+#include <stdlib.h>
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define BUF_SIZE (512 * 1024)
+#define DATA_SIZE (256 * 1024)
+#define PASSES 3
+
+static char buf[BUF_SIZE];
+
+/* Initialized, so that it is loaded from the executable rather
+   than zero-filled. */
+static const char data[DATA_SIZE] = { 1 };
+
+/* Byte that page PAGE_NO of buf holds after pass PASS of child
+   ID. */
+static char
+pattern (int id, int pass, size_t page_no)
+{
+  return (id * 31 + pass * 7 + page_no) & 0xff;
+}
+
+/* Checks every byte of the data page at OFS. */
+static void
+check_data (size_t ofs)
+{
+  const volatile char *p = data + ofs;
+  size_t i;
+
+  for (i = 0; i < PAGE; i++)
+    if (p[i] != (ofs + i == 0))
+      fail ("data byte %zu is %d", ofs + i, p[i]);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int id = atoi (argv[argc - 1]);
+  int pass;
+  size_t i, j;
+
+  test_name = "child-fault";
+
+  for (pass = 0; pass < PASSES; pass++)
+    {
+      for (i = 0; i < BUF_SIZE / PAGE; i++)
+        {
+          memset (buf + i * PAGE, pattern (id, pass, i), PAGE);
+          check_data (i * PAGE % DATA_SIZE);
+        }
+      for (i = 0; i < BUF_SIZE / PAGE; i++)
+        for (j = 0; j < PAGE; j++)
+          if (buf[i * PAGE + j] != pattern (id, pass, i))
+            fail ("pass %d: byte %zu is %d, not %d", pass, i * PAGE + j,
+                  buf[i * PAGE + j], pattern (id, pass, i));
+    }
+  return 0x42;
+}
@@ -0,0 +1,45 @@
+/* Writes to a file through a mapping and reads the data back
+   using the read system call while the file is still mapped, then
+   writes to the file and checks that the mapping sees the data,
+   all without unmapping in between. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+
+void
+test_main (void)
+{
+  size_t len = strlen (sample);
+  int handle;
+  mapid_t map;
+  char buf[1024];
+  size_t i;
+
+  CHECK (create ("sample.txt", len), "create \"sample.txt\"");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"sample.txt\"");
+
+  /* Write via the mapping, read via read(). */
+  memcpy (ACTUAL, sample, len);
+  if (read (handle, buf, len) != (int) len)
+    fail ("read() returned short");
+  CHECK (!memcmp (buf, sample, len),
+         "read() sees data written through the mapping");
+
+  /* Write via write(), read via the mapping. */
+  for (i = 0; i < len; i++)
+    buf[i] = sample[len - 1 - i];
+  seek (handle, 0);
+  if (write (handle, buf, len) != (int) len)
+    fail ("write() returned short");
+  CHECK (!memcmp (ACTUAL, buf, len),
+         "mapping sees data written by write()");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,30 @@
+/* Runs 4 child-fault processes at once.  Together they dirty more
+   pages than fit in memory, so that each keeps evicting to swap
+   while the others fault on file-backed pages; those faults should
+   be served in parallel with the write-back rather than behind it,
+   and every child must still see its own data intact. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      char cmd[128];
+      snprintf (cmd, sizeof cmd, "child-fault %d", i);
+      CHECK ((children[i] = exec (cmd)) != -1,
+             "exec \"%s\"", cmd);
+    }
+
+  for (i = 0; i < CHILD_CNT; i++) 
+    CHECK (wait (children[i]) == 0x42, "wait for child %d", i);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-fault-par) begin
+(page-fault-par) exec "child-fault 0"
+(page-fault-par) exec "child-fault 1"
+(page-fault-par) exec "child-fault 2"
+(page-fault-par) exec "child-fault 3"
+(page-fault-par) wait for child 0
+(page-fault-par) wait for child 1
+(page-fault-par) wait for child 2
+(page-fault-par) wait for child 3
+(page-fault-par) end
+EOF
+our ($test);
+my ($ticks) = map (/^Execution of '.*' took (\d+) ticks\.$/,
+		   read_text_file ("$test.output"));
+fail "missing tick count" if !defined $ticks;
+pass ("page-fault-par: $ticks ticks");
@@ -38,6 +38,10 @@
 #include "filesys/fsutil.h"
 #include "vm/swap.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/pcache.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -158,12 +162,12 @@ bss_init (void)
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
    directory it creates. */
-struct list lru_list;
 static void
 paging_init (void)
 {
 #ifdef VM
-  init_lru();
+  frame_init ();
+  pcache_init ();
 #endif
   uint32_t *pd, *pt;
   size_t page;
@@ -267,6 +271,13 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-rp"))
+        {
+          if (value == NULL || !frame_set_policy (value))
+            PANIC ("unknown replacement policy `%s'", value);
+        }
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -285,19 +296,24 @@ parse_options (char **argv)
   return argv;
 }
 
-/* Runs the task specified in ARGV[1]. */
+/* Runs the task specified in ARGV[1] and reports how many timer
+   ticks it took, which the benchmark tests pick up. */
 static void
 run_task (char **argv)
 {
   const char *task = argv[1];
+  int64_t start;
   
   printf ("Executing '%s':\n", task);
+  start = timer_ticks ();
 #ifdef USERPROG
   process_wait (process_execute (task));
 #else
   run_test (task);
 #endif
   printf ("Execution of '%s' complete.\n", task);
+  printf ("Execution of '%s' took %"PRId64" ticks.\n",
+          task, timer_elapsed (start));
 }
 
 /* Executes all of the actions specified in ARGV[]
@@ -391,6 +407,10 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -rp=POLICY         Replace pages with POLICY: clock (default),\n"
+          "                     wsclock or aging.\n"
 #endif
           );
   shutdown_power_off ();
@@ -9,6 +9,7 @@
 #include "filesys/file.h"
 // #include "lib/user/syscall.h"
 #include "syscall.h"
+#include "userprog/process.h"
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -171,12 +172,14 @@ page_fault (struct intr_frame *f)
    uint32_t* sp = user ? f->esp : thread_current()->stack;
 //   printf("%p %s %s\n",fault_addr,user ? "user " : "kernel",write ? "write" : "read");
  
-  if(not_present||user&&is_user_vaddr(fault_addr)){
+  /* Kernel writes to user pages also come here, so that a read()
+     into a buffer that still maps the zero frame copies it. */
+  if(not_present||is_user_vaddr(fault_addr)){
       // d
       if(not_present){
          // printf("%p %s %s\n",fault_addr,user ? "user " : "kernel",write ? "write" : "read");
          }
-      if(handle_mm_fault(fault_addr,sp)){ // how to handle kernel stack ??
+      if(handle_mm_fault(fault_addr,sp,write)){ // how to handle kernel stack ??
          return;
       }
   }
@@ -6,7 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "userprog/gdt.h"
-// #include "userprog/pagedir.h"
+#include "userprog/pagedir.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -25,6 +25,7 @@
 #include "vm/page.h"
 #include "threads/pte.h"
 #include "vm/swap.h"
+#include "vm/frame.h"
 #endif
 #define WORD_SIZE 4
 
@@ -34,33 +35,13 @@
                       
 
 struct list all_list;
-struct list lru_list;
-struct lock lru_lock;
-static struct kpage_t* lru_selected;
-void init_lru(){
-  list_init(&lru_list);
-  lock_init(&lru_lock);
-  lru_selected=NULL;
-}
-
-void insert_lru_list(struct kpage_t* page){
-  lock_acquire(&lru_lock);
-  list_push_back(&lru_list,&page->lru_elem);
-  lock_release(&lru_lock);
-}
-
-void remove_lru_elem(struct kpage_t* page){
-  lock_acquire(&lru_lock);
-  list_remove(&page->lru_elem);
-  lock_release(&lru_lock);
-}
-
-
 struct semaphore* file_handle_lock;
 
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
-static bool expand_stack();
+static bool expand_stack(uint32_t* uaddr,bool write);
+static void swap_read_around(void* vaddr,block_sector_t sector);
 static inline void parse_elf_name(const char* src,char* dst) {
   size_t i;
   size_t len=strlen(src);
@@ -255,6 +236,239 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+/* Passed from process_fork() to start_fork(). */
+struct fork_aux{
+  struct thread* parent;
+  struct intr_frame if_;  /* Parent's user context at the syscall. */
+  bool success;           /* Set by the child before waking the parent. */
+};
+
+/* Creates a child of the current process that resumes from the
+   system call in IF_ with a copy of the parent's address space,
+   open files and mappings.  Resident pages are shared
+   copy-on-write instead of copied.  Returns the child's thread id,
+   or TID_ERROR if it could not be created. */
+tid_t
+process_fork (struct intr_frame *if_)
+{
+  struct thread* cur=thread_current();
+  struct thread* created;
+  struct fork_aux aux;
+
+  aux.parent=cur;
+  aux.if_=*if_;
+  aux.success=false;
+  created=thread_create(cur->name,PRI_DEFAULT,start_fork,&aux);
+  if(created==(struct thread*)TID_ERROR){
+    return TID_ERROR;
+  }
+  sema_down(&cur->child_sema);
+  if(!aux.success){
+    created->tid=TID_ERROR;
+  }
+  return created->tid;
+}
+
+/* Returns the current process's copy of PF, one of PARENT's
+   files, or NULL.  fork_files() copies open_file_list in order,
+   so the copy sits at the same position. */
+static struct file* child_file(struct thread* parent,struct file* pf){
+  struct list* plist=&parent->open_file_list;
+  struct list* clist=&thread_current()->open_file_list;
+  struct list_elem* p;
+  struct list_elem* c;
+  for(p=list_begin(plist),c=list_begin(clist);p!=list_end(plist)&&c!=list_end(clist);
+      p=list_next(p),c=list_next(c)){
+    if(list_entry(p,struct file,elem)==pf){
+      return list_entry(c,struct file,elem);
+    }
+  }
+  return NULL;
+}
+
+/* Gives the current process its own handle on each of PARENT's
+   open files, with the same descriptors and positions. */
+static bool fork_files(struct thread* parent){
+  struct thread* cur=thread_current();
+  struct list_elem* iter;
+
+  for(iter=list_begin(&parent->open_file_list);iter!=list_end(&parent->open_file_list);iter=list_next(iter)){
+    struct file* pf=list_entry(iter,struct file,elem);
+    struct file* cf=file_reopen(pf);
+    if(cf==NULL){
+      return false;
+    }
+    cf->fd=pf->fd;
+    cf->pos=pf->pos;
+    if(pf->deny_write){
+      file_deny_write(cf);
+    }
+    list_push_back(&cur->open_file_list,&cf->elem);
+  }
+  for(iter=list_begin(&parent->free_fd_list);iter!=list_end(&parent->free_fd_list);iter=list_next(iter)){
+    struct free_fd_elem* pff=list_entry(iter,struct free_fd_elem,elem);
+    struct free_fd_elem* cff=malloc(sizeof* cff);
+    if(cff==NULL){
+      return false;
+    }
+    cff->fd=pff->fd;
+    list_push_back(&cur->free_fd_list,&cff->elem);
+  }
+  cur->cur_max_fd=parent->cur_max_fd;
+  if(parent->executing!=NULL){
+    cur->executing=file_reopen(parent->executing);
+    if(cur->executing==NULL){
+      return false;
+    }
+    file_deny_write(cur->executing);
+  }
+  return true;
+}
+
+/* Copies PVME, one of PARENT's pages, into the current process,
+   as part of MMAP_FILE if that is not NULL.  A resident page ends
+   up in one frame mapped by both processes, read-only in both if
+   it is writable, so that the first write through either takes
+   a copy; a swapped-out page shares its swap slot.  A resident
+   mmap page stays writable in both instead, since the two map the
+   same page of the file, and keeps its dirty bit, since the
+   parent's writes are in the frame and not yet in the file.
+   Caller must hold frame_lock. */
+static bool fork_vme(struct thread* parent,struct vm_entry* pvme,struct mmap_file* mmap_file){
+  struct thread* cur=thread_current();
+  struct vm_entry* vme=malloc(sizeof* vme);
+  struct kpage_t* page;
+  uint32_t* ppte;
+  uint32_t* pte;
+
+  if(vme==NULL){
+    return false;
+  }
+  frame_wait_evicted(pvme);
+  *vme=*pvme;
+  vme->mmap_file=mmap_file;
+  if(mmap_file!=NULL){
+    vme->file=mmap_file->file;
+    list_push_back(&mmap_file->vme_list,&vme->mmap_elem);
+  }
+  else if(vme->type==VM_BIN){
+    vme->file=child_file(parent,pvme->file);
+  }
+  vme->loaded_on_phys=false;
+  vme->zero_mapped=false;
+  vme->cow=false;
+  vme->evicting=false;
+  insert_vme(&cur->vm,vme);
+
+  if(!pvme->loaded_on_phys){
+    if(pvme->type==VM_ANON&&pvme->swap_sector!=(block_sector_t)NOT_IN_SWAP){
+      swap_dup(pvme->swap_sector);
+    }
+    return true;
+  }
+  if(pvme->zero_mapped){
+    if(!pagedir_set_page(cur->pagedir,vme->vaddr,zero_frame,false)){
+      return false;
+    }
+    vme->loaded_on_phys=true;
+    vme->zero_mapped=true;
+    return true;
+  }
+
+  ppte=lookup_page(parent->pagedir,pvme->vaddr,false);
+  ASSERT(ppte!=NULL&&(*ppte&PTE_P));
+  page=malloc(sizeof* page);
+  if(page==NULL||!pagedir_set_page(cur->pagedir,vme->vaddr,pte_get_page(*ppte),
+                                   pvme->type==VM_FILE&&pvme->writable)){
+    free(page);
+    return false;
+  }
+  if(pvme->writable&&pvme->type!=VM_FILE){
+    *ppte&=~PTE_W;
+    invalidate_pagedir(parent->pagedir);
+    pvme->cow=vme->cow=true;
+  }
+  /* The parent's writes are in the frame, not in the file. */
+  pte=lookup_page(cur->pagedir,vme->vaddr,false);
+  *pte|=*ppte&PTE_D;
+  vme->loaded_on_phys=true;
+  page->kaddr=pte_get_page(*ppte);
+  page->vme=vme;
+  page->thread=cur;
+  page->prefetched=false;
+  frame_share(page);
+  return true;
+}
+
+/* Duplicates PARENT's supplemental page table and mmap regions
+   into the current process.  Holds frame_lock throughout, so
+   none of PARENT's pages is evicted halfway. */
+static bool fork_address_space(struct thread* parent){
+  struct thread* cur=thread_current();
+  struct hash_iterator i;
+  struct list_elem* iter;
+  bool success=true;
+
+  lock_acquire(&frame_lock);
+  hash_first(&i,&parent->vm);
+  while(success&&hash_next(&i)){
+    struct vm_entry* pvme=hash_entry(hash_cur(&i),struct vm_entry,h_elem);
+    if(pvme->type!=VM_FILE){
+      success=fork_vme(parent,pvme,NULL);
+    }
+  }
+  for(iter=list_begin(&parent->mmap_list);success&&iter!=list_end(&parent->mmap_list);iter=list_next(iter)){
+    struct mmap_file* pmf=list_entry(iter,struct mmap_file,elem);
+    struct mmap_file* mf=malloc(sizeof* mf);
+    struct list_elem* v;
+    if(mf==NULL||(mf->file=file_reopen(pmf->file))==NULL){
+      free(mf);
+      success=false;
+      break;
+    }
+    mf->mapid=pmf->mapid;
+    list_init(&mf->vme_list);
+    list_push_back(&cur->mmap_list,&mf->elem);
+    for(v=list_begin(&pmf->vme_list);success&&v!=list_end(&pmf->vme_list);v=list_next(v)){
+      success=fork_vme(parent,list_entry(v,struct vm_entry,mmap_elem),mf);
+    }
+  }
+  cur->cur_max_mapid=parent->cur_max_mapid;
+  lock_release(&frame_lock);
+  return success;
+}
+
+/* A thread function that becomes the child of a fork(). */
+static void
+start_fork (void *aux_)
+{
+  struct fork_aux* aux=aux_;
+  struct thread* cur=thread_current();
+  struct thread* parent=aux->parent;
+  struct intr_frame if_=aux->if_;
+  bool success;
+
+  vm_init(&cur->vm);
+  list_init(&cur->kpage_list);
+  cur->pagedir=pagedir_create();
+  success=cur->pagedir!=NULL&&fork_files(parent);
+  if(success){
+    process_activate();
+    success=fork_address_space(parent);
+  }
+  aux->success=success;
+  sema_up(&parent->child_sema);
+  if(!success){
+    cur->exit_status=-1;
+    thread_exit();
+  }
+
+  /* fork() returns 0 in the child. */
+  if_.eax=0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -300,9 +514,14 @@ process_exit (void)
   uint32_t *pd;
   struct list_elem* iter;
   struct thread* t_iter;
-  struct kpage_t* kp_iter;
   printf("%s: exit(%d)\n",cur->name,cur->exit_status);
 
+  /* Before the files are closed: page cache entries hold no
+     reference to their inode, so they must be gone by the time a
+     removed executable's inode can be freed and reused. */
+  frame_unmap(NULL);
+  all_mmap_destroy(&cur->mmap_list);
+
   if(cur->executing){
 
     struct list* open_file_list=&cur->open_file_list;
@@ -324,25 +543,7 @@ process_exit (void)
     }
   }
   
-  lock_acquire(&lru_lock);
-  for(iter=list_begin(&cur->kpage_list);iter!=list_end(&cur->kpage_list);) {
-    kp_iter=list_entry(iter,struct kpage_t,elem);
-    swap_free(kp_iter);
-    if(kp_iter==lru_selected){
-      iter=list_next(iter);
-      continue;
-    }
-    list_remove(&kp_iter->lru_elem);
-    // if(kp_iter->vme->type==VM_ANON&&!kp_iter->vme->loaded_on_phys){
-    //   swap_free(kp_iter);
-    // }
-    iter=list_remove(iter);
-    free(kp_iter);
-  }
-
-  all_mmap_destroy(&cur->mmap_list);
   vm_destroy(&cur->vm);
-  lock_release(&lru_lock);
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -731,6 +932,10 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       vme->offset=ofs;
       vme->vaddr=upage;
       vme->loaded_on_phys=false;
+      vme->zero_mapped=false;
+      vme->cow=false;
+      vme->evicting=false;
+      vme->swap_sector=NOT_IN_SWAP;
       vme->writable=writable;
       vme->type=VM_BIN;
       ofs+=PGSIZE;
@@ -773,7 +978,7 @@ static bool
 setup_stack (void **esp) 
 {
   bool success = false;
-  success=expand_stack(PHYS_BASE-PGSIZE);
+  success=expand_stack(PHYS_BASE-PGSIZE,true);
   if (success){
     *esp = PHYS_BASE;
   }
@@ -802,64 +1007,167 @@ install_page (void *upage, void *kpage, bool writable)
 void bf(){
   // printf("breakpoint\n");
 }
-static uint32_t* demand_paging(void){
-
-  struct list_elem* iter;
-  struct kpage_t* kp_iter;
-  void* kaddr;
-  void* vaddr;
-  uint32_t * pte;
-  int i=0;
-  kaddr=palloc_get_page(PAL_USER|PAL_ZERO);
-  if(kaddr!=NULL){
-    return kaddr;
-  }
-
-  while(1){
-    for(iter=list_begin(&lru_list);iter!=list_end(&lru_list);iter=list_next(iter)){
-      kp_iter=list_entry(iter,struct kpage_t,lru_elem);
-      ASSERT(kp_iter->vme->loaded_on_phys==true);
-      kaddr=kp_iter->kaddr;
-      vaddr=kp_iter->vme->vaddr;
-      pte=lookup_page(kp_iter->thread->pagedir,vaddr,false);
-
-      i++;
-      if(kp_iter==lru_selected){
-        continue;
+/* Pages on each side of a faulting page that swap_read_around()
+   looks at. */
+#define READ_AROUND_PAGES (SWAP_BATCH_MAX-1)
+
+/* Brings in the current process's pages next to VADDR whose swap
+   slots continue on either side of SECTOR, the slot VADDR was just
+   read from.  Pages evicted together sit in adjacent slots, so
+   this reads them back in the same transfer.  Only frames that
+   are free right now are used; nothing is evicted for this. */
+static void swap_read_around(void* vaddr,block_sector_t sector){
+  struct thread* cur=thread_current();
+  struct kpage_t* pages[2*READ_AROUND_PAGES];
+  size_t cnt=0,i;
+  int dir,k;
+
+  for(dir=-1;dir<=1;dir+=2){
+    for(k=1;k<=READ_AROUND_PAGES;k++){
+      uint8_t* upage=(uint8_t*)vaddr+dir*k*PGSIZE;
+      struct vm_entry* vme;
+      struct kpage_t* page;
+      if(dir<0?upage>=(uint8_t*)vaddr:!is_user_vaddr(upage)){
+        break;
       }
-      if(*pte&(uint32_t)PTE_A){
-        *pte&=~(uint32_t)PTE_A;
-        invalidate_pagedir(kp_iter->thread->pagedir);
-        continue;
+      vme=find_vme(upage);
+      if(vme==NULL||vme->type!=VM_ANON||vme->loaded_on_phys
+         ||vme->swap_sector!=sector+dir*k*SECTOR_PER_PAGE){
+        break;
       }
-      lru_selected=kp_iter;
-      if(kp_iter->vme->type==VM_FILE&&*pte&PTE_D){
-        lock_acquire(file_handle_lock);
-        file_write_at(kp_iter->vme->file,kp_iter->vme->vaddr,PGSIZE,kp_iter->vme->offset);
-        lock_release(file_handle_lock);
-        *pte&=~PTE_D;
+      page=malloc(sizeof* page);
+      if(page==NULL){
+        break;
       }
-      else if(*pte&PTE_D||kp_iter->vme->type==VM_ANON){
-          *pte&=~PTE_D; // clear DIRTY BIT
-          kp_iter->vme->type=VM_ANON; // type is now anon
-          swap_out(kp_iter);
+      page->kaddr=frame_alloc(false);
+      if(page->kaddr==NULL){
+        free(page);
+        break;
       }
+      page->vme=vme;
+      page->thread=cur;
+      page->prefetched=true;
+      pages[cnt++]=page;
+    }
+  }
+  if(cnt==0){
+    return;
+  }
+
+  swap_in_batch(pages,cnt);
+  for(i=0;i<cnt;i++){
+    if(!install_page(pages[i]->vme->vaddr,pages[i]->kaddr,pages[i]->vme->writable)){
+      frame_free(pages[i]->kaddr);
+      free(pages[i]);
+      continue;
+    }
+    pages[i]->vme->loaded_on_phys=true;
+    pages[i]->vme->cow=false;
+    frame_set_page(pages[i]);
+  }
+}
 
-      list_remove(&kp_iter->elem);
-      list_remove(&kp_iter->lru_elem);
+/* Pages in the aligned block around a file-backed fault that
+   fault_around() tries to map. */
+#define FAULT_AROUND_PAGES 8
 
-      *pte&=~PTE_P;
-      invalidate_pagedir(kp_iter->thread->pagedir);
-      kp_iter->vme->loaded_on_phys=false;
+/* Results of load_file_page(). */
+enum load_result{
+  LOAD_FAILED,          /* Out of memory or short read. */
+  LOAD_SHARED,          /* Mapped a frame the page cache already had. */
+  LOAD_READ             /* Read from the file into a new frame. */
+};
 
-      memset(kaddr,0,PGSIZE);
-      free(kp_iter);
+/* Brings in VME, a page of VME->file, and maps it.  A page that
+   the page cache can hold is claimed there before it is read, so
+   that one frame at most ever holds it: a process that faults on
+   it meanwhile waits and then maps the same frame, and read()
+   and write() wait for the frame to be filled rather than race
+   the read.  Evicts to find a frame only if EVICT_OK. */
+static enum load_result load_file_page(struct vm_entry* vme,bool evict_ok){
+  struct kpage_t* page=malloc(sizeof* page);
 
-      return kaddr;
+  if(page==NULL){
+    return LOAD_FAILED;
+  }
+  page->kaddr=frame_alloc(evict_ok);
+  if(page->kaddr==NULL){
+    free(page);
+    return LOAD_FAILED;
+  }
+  page->vme=vme;
+  page->thread=thread_current();
+  page->prefetched=false;
+  switch(frame_claim(page)){
+  case FRAME_SHARED:
+    return LOAD_SHARED;
+  case FRAME_FAILED:
+    free(page);
+    return LOAD_FAILED;
+  default:
+    break;
+  }
+  if(file_read_at(vme->file,page->kaddr,vme->read_bytes,vme->offset)!=(off_t)vme->read_bytes
+     ||!install_page(vme->vaddr,page->kaddr,vme->writable)){
+    frame_free(page->kaddr);
+    free(page);
+    return LOAD_FAILED;
+  }
+  vme->loaded_on_phys=true;
+  vme->cow=false;
+  frame_set_page(page);
+  return LOAD_READ;
+}
+
+/* Maps the not yet loaded pages of the current process that share
+   an aligned block of FAULT_AROUND_PAGES pages with VME, a file
+   page just faulted in, and that continue VME's file at the same
+   distance, so that running through a program or a mapping takes
+   one fault per block instead of one per page.  A page in the
+   page cache is mapped from there; any other is read, but only
+   into a frame that is free right now. */
+static void fault_around(struct vm_entry* vme){
+  uint8_t* start=(uint8_t*)((uintptr_t)vme->vaddr&~(uintptr_t)(FAULT_AROUND_PAGES*PGSIZE-1));
+  int k;
+
+  for(k=0;k<FAULT_AROUND_PAGES;k++){
+    uint8_t* upage=start+k*PGSIZE;
+    off_t delta=upage-(uint8_t*)vme->vaddr;
+    struct vm_entry* n;
+
+    if(delta==0||!is_user_vaddr(upage)){
+      continue;
+    }
+    n=find_vme(upage);
+    if(n==NULL||n->type!=vme->type||n->file==NULL||n->loaded_on_phys
+       ||file_get_inode(n->file)!=file_get_inode(vme->file)
+       ||n->offset!=vme->offset+delta||n->read_bytes==0){
+      continue;
+    }
+    switch(load_file_page(n,false)){
+    case LOAD_SHARED:
+      pcache_count_around(true);
+      break;
+    case LOAD_READ:
+      pcache_count_around(false);
+      break;
+    default:
+      return;
     }
+  }
+}
 
+/* Maps the shared zero frame read-only at VME's address, for a
+   read of a zero-fill page.  Returns false if the page table
+   could not be extended. */
+static bool map_zero_frame(struct vm_entry* vme){
+  if(!pagedir_set_page(thread_current()->pagedir,vme->vaddr,zero_frame,false)){
+    return false;
   }
-  NOT_REACHED();
+  vme->loaded_on_phys=true;
+  vme->zero_mapped=true;
+  frame_count_zero_map(false);
+  return true;
 }
 
 static inline bool is_stack_boundary(uint32_t* sp,void* uaddr){
@@ -869,7 +1177,7 @@ static inline bool is_stack_boundary(uint32_t* sp,void* uaddr){
   return false;
 }
 
-static bool expand_stack(uint32_t* uaddr){
+static bool expand_stack(uint32_t* uaddr,bool write){
   uint32_t* round_down_uaddr=pg_round_down(uaddr);
   struct vm_entry* vme;
   struct kpage_t* page;
@@ -887,15 +1195,26 @@ static bool expand_stack(uint32_t* uaddr){
   vme->type=VM_ANON;
   vme->writable=true;
   vme->loaded_on_phys=true;
+  vme->zero_mapped=false;
+  vme->cow=false;
+  vme->evicting=false;
   vme->swap_sector=NOT_IN_SWAP;
   vme->vaddr=round_down_uaddr;
+  if(!write){
+    free(page);
+    if(!map_zero_frame(vme)){
+      free(vme);
+      return false;
+    }
+    insert_vme(&cur->vm,vme);
+    return true;
+  }
   page->vme=vme;
   page->thread=cur;
+  page->prefetched=false;
 
-  lock_acquire(&lru_lock);
-  kpage=demand_paging();
+  kpage=frame_alloc(true);
   ASSERT(kpage!=NULL);
-  lock_release(&lru_lock);
 
   page->kaddr=kpage;
 
@@ -903,25 +1222,22 @@ static bool expand_stack(uint32_t* uaddr){
     printf(" isntall page error\n");
     free(page);
     free(vme);
-    palloc_free_page(kpage);
+    frame_free(kpage);
     return false;
   }
   insert_vme(&cur->vm,vme);
-
-  lock_acquire(&lru_lock);
-  list_push_back(&cur->kpage_list,&page->elem);
-  list_push_back(&lru_list,&page->lru_elem);
-  lock_release(&lru_lock);
+  frame_set_page(page);
   return true;
 }
 
-bool handle_mm_fault(uint32_t* uaddr,uint32_t* sp){
+bool handle_mm_fault(uint32_t* uaddr,uint32_t* sp,bool write){
 
    struct thread* cur=thread_current();
    uint32_t* round_down_uaddr=pg_round_down(uaddr);
    struct vm_entry* vme=find_vme(round_down_uaddr);
    struct kpage_t* page;
    uint8_t *kpage;
+   block_sector_t swap_sector;
    if(vme==NULL){
       /*
         IF STACK
@@ -929,44 +1245,66 @@ bool handle_mm_fault(uint32_t* uaddr,uint32_t* sp){
         ELSE GOTO ERROR
       */
       if(is_stack_boundary(sp,uaddr)){
-        if(expand_stack(uaddr)){
+        if(expand_stack(uaddr,write)){
           return true;
         }
       }
       goto error;
    }
+   /* A page whose frame is being written out is not resident yet
+      but not loadable either; wait for the write to finish. */
+   lock_acquire(&frame_lock);
+   frame_wait_evicted(vme);
+   lock_release(&frame_lock);
+   if(vme->loaded_on_phys&&write&&vme->cow&&vme->writable){
+    if(!frame_break_cow(vme)){
+      goto error;
+    }
+    return true;
+   }
    if(vme->loaded_on_phys){
-    goto error;
+    /* Only a write to the zero frame is expected here: give the
+       page a frame of its own, which frame_alloc() zeroes. */
+    if(!write||!vme->zero_mapped||!vme->writable){
+      goto error;
+    }
+    pagedir_clear_page(cur->pagedir,round_down_uaddr);
+    vme->zero_mapped=false;
+    vme->loaded_on_phys=false;
+    frame_count_zero_map(true);
+   }
+   else if(!write&&is_zero_fill(vme)){
+    if(!map_zero_frame(vme)){
+      goto error;
+    }
+    return true;
+   }
+   if(vme->type==VM_BIN||vme->type==VM_FILE){
+    if(load_file_page(vme,true)==LOAD_FAILED){
+      goto error;
+    }
+    fault_around(vme);
+    return true;
    }
 
-    lock_acquire(&lru_lock);
-    kpage=demand_paging();
-    lock_release(&lru_lock);
+    kpage=frame_alloc(true);
     page=malloc(sizeof* page);
 
   if(page==NULL){
-    palloc_free_page(kpage);
+    frame_free(kpage);
     goto error;
   }
    page->vme=vme;
    page->kaddr=kpage;
+   page->prefetched=false;
+   swap_sector=vme->swap_sector;
 
     switch (vme->type)
     {
-    case VM_FILE:
-    case VM_BIN:
-
-      file_seek(vme->file,vme->offset);
-      EXPECT_EQ(vme->file->pos,vme->offset);
-      size_t file_read_size=file_read(vme->file,page->kaddr,vme->read_bytes);
-      // if(vme->type==VM_FILE)
-      // EXPECT_NE(file_read_size,vme->read_bytes);
-      if( file_read_size!=(int)vme->read_bytes){
-          goto error;
-      }
-      break;
     case VM_ANON:
-      swap_in(page);
+      if(swap_sector!=(block_sector_t)NOT_IN_SWAP){
+        swap_in(page);
+      }
       break;
 
     default:
@@ -976,19 +1314,20 @@ bool handle_mm_fault(uint32_t* uaddr,uint32_t* sp){
 
 
    if(!install_page(round_down_uaddr,kpage,vme->writable)){
-      palloc_free_page(kpage);
+      free(page);
+      frame_free(kpage);
       goto error;
    }
 
    vme->loaded_on_phys=true;
+   vme->cow=false;
    page->vme=vme;
    page->kaddr=kpage;
    page->thread=cur;
    ASSERT(page->vme->vaddr!=NULL);
-   lock_acquire(&lru_lock);
-   list_push_back(&lru_list,&page->lru_elem);
-   list_push_back(&cur->kpage_list,&page->elem);
-   lock_release(&lru_lock);
+   frame_set_page(page);
+   if(vme->type==VM_ANON&&swap_sector!=(block_sector_t)NOT_IN_SWAP)
+     swap_read_around(vme->vaddr,swap_sector);
    return true;
 error:
   // printf("exit here\n");
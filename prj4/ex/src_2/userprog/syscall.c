@@ -99,13 +99,16 @@ static void syscall_mmap(struct intr_frame* f);
 
 static void syscall_munmap(struct intr_frame* f);
 
+static void syscall_fork(struct intr_frame* f);
+
 struct syscall_handler_t syscall_handlers[]=
                       {{syscall_halt,"halt",0},{syscall_exit,"exit",1},{syscall_exec,"exec",1},
                         {syscall_wait,"wait",1},{syscall_create,"create",2},{syscall_remove,"remove",1},
                         {syscall_open,"open",1},{syscall_filesize,"filesize",1},{syscall_read,"read",1},
                         {syscall_write,"write",3},{syscall_seek,"seek",2},{syscall_tell,"tell",1},
                         {syscall_close,"close",1},{syscall_max_of_four_int,"max_of_four_int",4},
-                        {syscall_fibonacci,"fibonacci",1},{syscall_mmap,"mmap",2},{syscall_munmap,"munmap",1}};
+                        {syscall_fibonacci,"fibonacci",1},{syscall_mmap,"mmap",2},{syscall_munmap,"munmap",1},
+                        {syscall_fork,"fork",0}};
 
 
 static inline bool is_valid_vaddr(uint32_t * esp){
@@ -454,6 +457,9 @@ static void syscall_mmap(struct intr_frame* f){
     }
     vme->file=file;
     vme->loaded_on_phys=false;
+    vme->zero_mapped=false;
+    vme->cow=false;
+    vme->evicting=false;
     vme->type=VM_FILE;
     vme->offset=off;
     vme->read_bytes= fsize-off >= (PGSIZE) ? (PGSIZE) : fsize-off;
@@ -489,8 +495,11 @@ static void syscall_munmap(struct intr_frame* f){
     // _exit(-1);
     return;
   }
-  list_remove(&mmap_file->elem);
   mmap_destroy(mmap_file,true);
   free(mmap_file);
 
-}
\ No newline at end of file
+}
+
+static void syscall_fork(struct intr_frame* f){
+  f->eax=process_fork(f);
+}
@@ -0,0 +1,727 @@
+#include "frame.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "userprog/pagedir.h"
+#include "vm/swap.h"
+
+/* Most frames reclaimed by one eviction.  The cold anonymous
+   pages among them are swapped out together. */
+#define EVICT_BATCH SWAP_BATCH_MAX
+
+struct lock frame_lock;
+void* zero_frame;
+
+/* Signaled, with frame_lock, whenever evict() finishes writing out
+   a batch of frames and whenever a page cache frame claimed by
+   frame_claim() is filled or given up. */
+static struct condition io_done;
+
+/* Frame table, one entry for every page of physical memory.
+   User frames lie in [frame_lo, frame_hi]; the clock hand only
+   sweeps that range and stays where it stopped between calls. */
+static struct frame* frames;
+static size_t frame_lo;
+static size_t frame_hi;
+static size_t clock_hand;
+
+/* Statistics. */
+static long long eviction_cnt;      /* Calls to evict(). */
+static long long evicted_cnt;       /* Frames reclaimed by them. */
+static long long dropped_cnt;       /* ...from clean file pages. */
+static long long written_cnt;       /* ...by writing back to a file. */
+static long long swapped_cnt;       /* ...by writing to swap. */
+static long long zero_map_cnt;      /* Reads mapped to zero_frame. */
+static long long zero_copy_cnt;     /* Writes that then got a frame. */
+static long long cow_copy_cnt;      /* Writes that copied a shared frame. */
+static long long unmap_batch_cnt;   /* Batches taken by frame_unmap(). */
+static long long written_run_cnt;   /* Runs of mmap pages it wrote back. */
+
+static void account_prefetch(struct kpage_t* page,uint32_t pte);
+
+static inline struct frame* frame_of(void* kaddr){
+    return &frames[vtop(kaddr)>>PGBITS];
+}
+
+static inline void* frame_address(struct frame* f){
+    return ptov((uintptr_t)(f-frames)<<PGBITS);
+}
+
+/* Gives F, which nothing maps or pins any longer, back to the
+   user pool, dropping its page cache entry first. */
+static void release_frame(struct frame* f){
+    if(f->cached!=NULL){
+        pcache_remove(f->cached);
+        f->cached=NULL;
+    }
+    palloc_free_page(frame_address(f));
+}
+
+/* Returns the page table entry that maps PAGE. */
+static inline uint32_t* pte_of(struct kpage_t* page){
+    return lookup_page(page->thread->pagedir,page->vme->vaddr,false);
+}
+
+/* Clears the accessed bit of every mapping of F and returns
+   whether any was set. */
+static bool test_and_clear_accessed(struct frame* f){
+    struct kpage_t* page;
+    bool accessed=false;
+    for(page=f->page;page!=NULL;page=page->next_map){
+        uint32_t* pte=pte_of(page);
+        account_prefetch(page,*pte);
+        if(*pte&PTE_A){
+            *pte&=~(uint32_t)PTE_A;
+            invalidate_pagedir(page->thread->pagedir);
+            accessed=true;
+        }
+    }
+    return accessed;
+}
+
+/* Returns whether any mapping of F has been written. */
+static bool is_dirty(struct frame* f){
+    struct kpage_t* page;
+    for(page=f->page;page!=NULL;page=page->next_map)
+        if(*pte_of(page)&PTE_D)
+            return true;
+    return false;
+}
+
+/* Clock: a used page gets a second chance. */
+static bool clock_keep(struct frame* f){
+    return test_and_clear_accessed(f);
+}
+
+/* Ticks a page stays in the working set after its last use. */
+#define WSCLOCK_WINDOW (TIMER_FREQ/4)
+
+/* WSClock: a page is kept while it has been used within the last
+   WSCLOCK_WINDOW ticks, so only pages that dropped out of their
+   process's working set are evicted. */
+static bool wsclock_keep(struct frame* f){
+    int64_t now=timer_ticks();
+    if(test_and_clear_accessed(f)){
+        f->last_use=now;
+        return true;
+    }
+    return now-f->last_use<WSCLOCK_WINDOW;
+}
+
+/* Lowest age of any resident frame at the last aging_begin(). */
+static uint8_t aging_min;
+
+/* Aging: shifts every resident frame's accessed bit into its age
+   counter and finds the lowest age.  Runs once per eviction,
+   which is when the samples matter. */
+static void aging_begin(void){
+    size_t pfn;
+    aging_min=UINT8_MAX;
+    for(pfn=frame_lo;pfn<=frame_hi;pfn++){
+        struct frame* f=&frames[pfn];
+        if(f->page==NULL)
+            continue;
+        f->age=(f->age>>1)|(test_and_clear_accessed(f)?0x80:0);
+        if(f->pin_cnt==0&&f->age<aging_min)
+            aging_min=f->age;
+    }
+}
+
+/* Aging: only the least recently used frames are evicted. */
+static bool aging_keep(struct frame* f){
+    return f->age>aging_min;
+}
+
+static const struct replacement_policy policies[]={
+    {"clock",NULL,clock_keep},
+    {"wsclock",NULL,wsclock_keep},
+    {"aging",aging_begin,aging_keep},
+};
+static const struct replacement_policy* policy=&policies[0];
+
+/* Selects the replacement policy called NAME.  Returns false if
+   there is no such policy. */
+bool frame_set_policy(const char* name){
+    size_t i;
+    for(i=0;i<sizeof policies/sizeof *policies;i++)
+        if(!strcmp(name,policies[i].name)){
+            policy=&policies[i];
+            return true;
+        }
+    return false;
+}
+
+void frame_init(void){
+    size_t size=init_ram_pages*sizeof *frames;
+    frames=palloc_get_multiple(PAL_ASSERT|PAL_ZERO,DIV_ROUND_UP(size,PGSIZE));
+    zero_frame=palloc_get_page(PAL_ASSERT|PAL_ZERO);
+    frame_lo=init_ram_pages;
+    frame_hi=0;
+    clock_hand=0;
+    lock_init(&frame_lock);
+    cond_init(&io_done);
+}
+
+/* Counts a read-around page as a hit once its accessed bit,
+   taken from PTE, shows that its owner touched it.  The page is
+   judged only once. */
+static void account_prefetch(struct kpage_t* page,uint32_t pte){
+    if(page->prefetched&&(pte&PTE_A))
+        swap_count_prefetch_hit();
+    if(pte&PTE_A)
+        page->prefetched=false;
+}
+
+/* Returns whether F can be dropped without any I/O: it holds a
+   file-backed page that has not been written. */
+static bool is_clean_file(struct frame* f){
+    uint8_t type=f->page->vme->type;
+    return (type==VM_BIN||type==VM_FILE)&&!is_dirty(f);
+}
+
+/* Sweeps the clock hand for at most LAPS laps, pinning up to
+   EVICT_BATCH victims and storing them in VICTIMS; a lap that ends
+   with victims in hand ends the sweep.  On the first lap the
+   policy may keep frames, later laps take whatever is not pinned.
+   If CLEAN_ONLY, only clean file-backed pages are taken.  Returns
+   the number of victims. */
+static size_t sweep(struct frame** victims,size_t laps,bool clean_only){
+    size_t span=frame_hi-frame_lo+1;
+    size_t victim_cnt=0,step;
+
+    for(step=0;step<laps*span&&victim_cnt<EVICT_BATCH;step++){
+        struct frame* f=&frames[clock_hand];
+        bool first_lap=step<span;
+        clock_hand=clock_hand==frame_hi?frame_lo:clock_hand+1;
+
+        if(step%span==0&&victim_cnt>0)
+            break;
+        if(f->page==NULL||f->pin_cnt>0)
+            continue;
+        /* Before the policy, which may age the frame: a clean-only
+           sweep must leave the frames it cannot take as they were. */
+        if(clean_only&&!is_clean_file(f))
+            continue;
+        if(first_lap&&policy->keep(f))
+            continue;
+        f->pin_cnt++;
+        victims[victim_cnt++]=f;
+    }
+    return victim_cnt;
+}
+
+/* Unmaps every mapping of F, so that a later access by any owner
+   faults instead of being lost, and returns whether any of them
+   had written the page. */
+static bool unmap_all(struct frame* f){
+    struct kpage_t* page;
+    bool dirty=false;
+    for(page=f->page;page!=NULL;page=page->next_map){
+        uint32_t* pte=pte_of(page);
+        page->prefetched=false;
+        dirty|=(*pte&PTE_D)!=0;
+        *pte&=~(PTE_P|PTE_D);
+        invalidate_pagedir(page->thread->pagedir);
+    }
+    return dirty;
+}
+
+/* Picks up to EVICT_BATCH frames with the replacement policy,
+   writes their pages out and returns one of the frames, zeroed
+   and still pinned; the rest go back to the user pool for the
+   faults that follow.  Clean file-backed pages cost nothing to
+   drop and read again later, so one lap looks for those first;
+   only if there are none does a second sweep, of up to two laps,
+   take dirty and anonymous pages.  A frame shared after fork()
+   is written out once and every sharer is pointed at the copy.
+
+   Caller must hold frame_lock, which is released while the pages
+   are written, so that other faults do not wait for the disk.
+   The victims stay pinned meanwhile, and their pages are marked
+   evicting: their owners wait in frame_wait_evicted() before
+   faulting them back in or tearing them down, and the page cache
+   neither shares nor copies into them. */
+static void* evict(void){
+    struct frame* victims[EVICT_BATCH];
+    struct kpage_t* swap_batch[EVICT_BATCH];
+    struct kpage_t* write_batch[EVICT_BATCH];
+    size_t victim_cnt,swap_cnt=0,write_cnt=0;
+    size_t i;
+    struct kpage_t* page;
+    void* kaddr;
+
+    if(frame_lo>frame_hi)
+        PANIC("no user frames to evict");
+    if(clock_hand<frame_lo||clock_hand>frame_hi)
+        clock_hand=frame_lo;
+    if(policy->begin!=NULL)
+        policy->begin();
+
+    victim_cnt=sweep(victims,1,true);
+    if(victim_cnt==0)
+        victim_cnt=sweep(victims,2,false);
+    if(victim_cnt==0)
+        PANIC("every user frame is pinned");
+
+    for(i=0;i<victim_cnt;i++){
+        struct frame* f=victims[i];
+        bool dirty=unmap_all(f);
+        f->evictor=thread_current();
+        for(page=f->page;page!=NULL;page=page->next_map)
+            page->vme->evicting=true;
+        page=f->page;
+
+        if(page->vme->type==VM_FILE&&dirty)
+            write_batch[write_cnt++]=page;
+        else if(page->vme->type==VM_ANON||dirty)
+            swap_batch[swap_cnt++]=page;
+        else
+            dropped_cnt++;
+    }
+    written_cnt+=write_cnt;
+    swapped_cnt+=swap_cnt;
+    lock_release(&frame_lock);
+
+    for(i=0;i<write_cnt;i++){
+        page=write_batch[i];
+        /* Not under file_handle_lock: the faulting thread may
+           already hold it in read(), like frame_unmap(). */
+        file_write_at(page->vme->file,page->kaddr,page->vme->read_bytes,page->vme->offset);
+    }
+    if(swap_cnt>0)
+        swap_out_batch(swap_batch,swap_cnt);
+
+    lock_acquire(&frame_lock);
+    /* Sharers of a swapped frame all take a reference to its slot. */
+    for(i=0;i<swap_cnt;i++){
+        block_sector_t sector=swap_batch[i]->vme->swap_sector;
+        for(page=swap_batch[i];page!=NULL;page=page->next_map){
+            page->vme->type=VM_ANON; // type is now anon
+            if(page!=swap_batch[i]){
+                page->vme->swap_sector=sector;
+                swap_dup(sector);
+            }
+        }
+    }
+
+    kaddr=frame_address(victims[0]);
+    for(i=0;i<victim_cnt;i++){
+        struct frame* f=victims[i];
+        while(f->page!=NULL){
+            page=f->page;
+            f->page=page->next_map;
+            list_remove(&page->elem);
+            page->vme->loaded_on_phys=false;
+            page->vme->cow=false;
+            page->vme->evicting=false;
+            free(page);
+        }
+        f->evictor=NULL;
+        if(i>0){
+            f->pin_cnt--;
+            release_frame(f);
+        }
+        else if(f->cached!=NULL){
+            pcache_remove(f->cached);
+            f->cached=NULL;
+        }
+    }
+    cond_broadcast(&io_done,&frame_lock);
+    eviction_cnt++;
+    evicted_cnt+=victim_cnt;
+    memset(kaddr,0,PGSIZE);
+    return kaddr;
+}
+
+/* Waits, with frame_lock held, until VME's frame is no longer
+   being evicted.  VME is then not resident. */
+void frame_wait_evicted(struct vm_entry* vme){
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    while(vme->evicting)
+        cond_wait(&io_done,&frame_lock);
+}
+
+/* Returns the thread evicting the frame at KADDR, or NULL if it
+   is not being evicted.  Caller must hold frame_lock. */
+struct thread* frame_evictor(void* kaddr){
+    return frame_of(kaddr)->evictor;
+}
+
+/* Waits, with frame_lock held, for an eviction or a page cache
+   fill in progress to finish. */
+void frame_wait_io(void){
+    cond_wait(&io_done,&frame_lock);
+}
+
+/* Returns a zeroed user frame, pinned until frame_set_page() or
+   frame_free().  If none is free, evicts to make one when
+   EVICT_OK is true and returns NULL otherwise.  The eviction's
+   I/O is done without frame_lock. */
+void* frame_alloc(bool evict_ok){
+    void* kaddr;
+
+    lock_acquire(&frame_lock);
+    kaddr=palloc_get_page(PAL_USER|PAL_ZERO);
+    if(kaddr!=NULL)
+        frame_of(kaddr)->pin_cnt++;
+    else if(evict_ok)
+        kaddr=evict();
+    lock_release(&frame_lock);
+    return kaddr;
+}
+
+/* Makes PAGE, which its thread now maps, the only mapping of its
+   frame, adds it to the thread's kpage_list and drops the pin
+   taken by frame_alloc().  Caller must hold frame_lock. */
+static void set_page(struct kpage_t* page){
+    struct frame* f=frame_of(page->kaddr);
+    size_t pfn=f-frames;
+
+    ASSERT(f->page==NULL&&f->pin_cnt>0);
+    page->next_map=NULL;
+    f->page=page;
+    f->pin_cnt--;
+    f->last_use=timer_ticks();
+    f->age=0x80;
+    if(pfn<frame_lo)
+        frame_lo=pfn;
+    if(pfn>frame_hi)
+        frame_hi=pfn;
+    list_push_back(&page->thread->kpage_list,&page->elem);
+}
+
+/* Like set_page().  A frame claimed in the page cache by
+   frame_claim() is now filled, so the processes, read() and
+   write() calls waiting for it may go on. */
+void frame_set_page(struct kpage_t* page){
+    struct frame* f=frame_of(page->kaddr);
+
+    lock_acquire(&frame_lock);
+    set_page(page);
+    if(f->cached!=NULL){
+        pcache_loaded(f->cached);
+        cond_broadcast(&io_done,&frame_lock);
+    }
+    lock_release(&frame_lock);
+}
+
+/* Before PAGE's frame, fresh from frame_alloc(), is filled: if
+   PAGE is a read-only executable page or an mmap page, finds the
+   page cache's frame for it.  If there is one, frees PAGE's frame,
+   maps the cached one at PAGE's address and adds PAGE to its
+   mappings and its thread's kpage_list; PAGE is then loaded.
+   Otherwise the page cache records PAGE's frame as the one for
+   the page, and the caller must fill it and pass PAGE to
+   frame_set_page(), or give it up with frame_free(). */
+enum frame_claim_result frame_claim(struct kpage_t* page){
+    struct vm_entry* vme=page->vme;
+    struct frame* f=frame_of(page->kaddr);
+    void* kaddr;
+
+    if(!((vme->type==VM_BIN&&!vme->writable)||vme->type==VM_FILE))
+        return FRAME_PRIVATE;
+    lock_acquire(&frame_lock);
+    kaddr=pcache_claim(vme,page->kaddr);
+    if(kaddr==page->kaddr||kaddr==NULL){
+        lock_release(&frame_lock);
+        return kaddr!=NULL?FRAME_CLAIMED:FRAME_PRIVATE;
+    }
+    if(!pagedir_set_page(page->thread->pagedir,vme->vaddr,kaddr,vme->writable)){
+        lock_release(&frame_lock);
+        frame_free(page->kaddr);
+        return FRAME_FAILED;
+    }
+    ASSERT(f->page==NULL&&f->pin_cnt==1);
+    f->pin_cnt=0;
+    palloc_free_page(page->kaddr);
+    page->kaddr=kaddr;
+    vme->loaded_on_phys=true;
+    vme->cow=false;
+    frame_share(page);
+    lock_release(&frame_lock);
+    return FRAME_SHARED;
+}
+
+/* Adds PAGE as one more mapping of the frame at PAGE->kaddr, which
+   already has at least one or is in the page cache.  Caller must
+   hold frame_lock. */
+void frame_share(struct kpage_t* page){
+    struct frame* f=frame_of(page->kaddr);
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    ASSERT(f->page!=NULL||f->cached!=NULL);
+    page->next_map=f->page;
+    f->page=page;
+    list_push_back(&page->thread->kpage_list,&page->elem);
+}
+
+/* Records that the frame at KADDR is the page cache's copy of a
+   file page, so that E goes away with the frame.  Caller must hold
+   frame_lock. */
+void frame_set_cached(void* kaddr,struct pcache_entry* e){
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    frame_of(kaddr)->cached=e;
+}
+
+/* Returns a frame from frame_alloc() that was never given a page
+   to the user pool, giving up its page cache claim if it has
+   one. */
+void frame_free(void* kaddr){
+    struct frame* f=frame_of(kaddr);
+
+    lock_acquire(&frame_lock);
+    ASSERT(f->page==NULL);
+    f->pin_cnt=0;
+    if(f->cached!=NULL)
+        cond_broadcast(&io_done,&frame_lock);
+    release_frame(f);
+    lock_release(&frame_lock);
+}
+
+/* Unlinks PAGE from its frame's list of mappings. */
+static void unlink_page(struct frame* f,struct kpage_t* page){
+    struct kpage_t** p;
+    for(p=&f->page;*p!=page;p=&(*p)->next_map)
+        ASSERT(*p!=NULL);
+    *p=page->next_map;
+}
+
+/* Most pages unmapped under one hold of frame_lock. */
+#define UNMAP_BATCH 32
+
+/* Returns the current process's mapping of VME, or NULL if VME is
+   not resident in a frame.  Caller must hold frame_lock. */
+static struct kpage_t* find_page(struct vm_entry* vme){
+    uint32_t* pte=lookup_page(thread_current()->pagedir,vme->vaddr,false);
+    struct kpage_t* page;
+
+    if(pte==NULL||(*pte&PTE_P)==0||vme->zero_mapped)
+        return NULL;
+    for(page=frame_of(pte_get_page(*pte))->page;page!=NULL;page=page->next_map)
+        if(page->vme==vme)
+            return page;
+    return NULL;
+}
+
+/* Takes up to UNMAP_BATCH of the current process's pages off its
+   kpage_list into PAGES and pins their frames, so that they stay
+   mapped while they are written back.  If MMAP_FILE is not NULL,
+   takes the pages of its vme_list from *NEXT on instead, and
+   advances *NEXT.  Returns the number of pages taken. */
+static size_t collect(struct mmap_file* mmap_file,struct list_elem** next,struct kpage_t** pages){
+    struct list* kpage_list=&thread_current()->kpage_list;
+    size_t cnt=0;
+
+    lock_acquire(&frame_lock);
+    while(cnt<UNMAP_BATCH){
+        struct kpage_t* page;
+        struct vm_entry* vme;
+        if(mmap_file==NULL){
+            if(list_empty(kpage_list))
+                break;
+            page=list_entry(list_front(kpage_list),struct kpage_t,elem);
+            vme=page->vme;
+            if(vme->evicting){
+                /* evict() frees PAGE and takes it off the list. */
+                frame_wait_evicted(vme);
+                continue;
+            }
+            list_pop_front(kpage_list);
+        }
+        else{
+            if(*next==list_end(&mmap_file->vme_list))
+                break;
+            vme=list_entry(*next,struct vm_entry,mmap_elem);
+            *next=list_next(*next);
+            frame_wait_evicted(vme);
+            page=find_page(vme);
+            if(page==NULL)
+                continue;
+            list_remove(&page->elem);
+        }
+        frame_of(page->kaddr)->pin_cnt++;
+        pages[cnt++]=page;
+    }
+    lock_release(&frame_lock);
+    return cnt;
+}
+
+/* Writes the dirty mmap pages among PAGES, sorted by address,
+   back to their files, one file_write_at() per run of pages that
+   are adjacent both in memory and in the file.  The pages are
+   still mapped, so each run is written straight from its user
+   addresses. */
+static void write_back_runs(struct kpage_t** pages,size_t cnt){
+    size_t i,j;
+
+    for(i=0;i<cnt;i=j){
+        struct vm_entry* vme=pages[i]->vme;
+        size_t len=vme->read_bytes;
+
+        j=i+1;
+        if(vme->type!=VM_FILE||(*pte_of(pages[i])&PTE_D)==0)
+            continue;
+        for(;j<cnt;j++){
+            struct vm_entry* prev=pages[j-1]->vme;
+            struct vm_entry* next=pages[j]->vme;
+            if(next->type!=VM_FILE||next->file!=vme->file||prev->read_bytes!=PGSIZE
+               ||(uint8_t*)next->vaddr!=(uint8_t*)prev->vaddr+PGSIZE
+               ||next->offset!=prev->offset+PGSIZE||(*pte_of(pages[j])&PTE_D)==0)
+                break;
+            len+=next->read_bytes;
+        }
+        file_write_at(vme->file,vme->vaddr,len,vme->offset);
+        written_run_cnt++;
+    }
+}
+
+/* Unmaps the current process's resident pages: those of
+   MMAP_FILE, or all of them if it is NULL.  Dirty mmap pages are
+   written back first.  Frames no other process maps are freed.
+   Works UNMAP_BATCH pages at a time and holds frame_lock only to
+   take a batch and to release it, not across the write-back, and
+   flushes the TLB once per batch rather than once per page. */
+void frame_unmap(struct mmap_file* mmap_file){
+    struct thread* cur=thread_current();
+    struct kpage_t* pages[UNMAP_BATCH];
+    struct list_elem* next=mmap_file!=NULL?list_begin(&mmap_file->vme_list):NULL;
+    size_t cnt,i,j;
+
+    while((cnt=collect(mmap_file,&next,pages))>0){
+        /* kpage_list is in fault order; runs need address order. */
+        for(i=1;i<cnt;i++){
+            struct kpage_t* page=pages[i];
+            for(j=i;j>0&&pages[j-1]->vme->vaddr>page->vme->vaddr;j--)
+                pages[j]=pages[j-1];
+            pages[j]=page;
+        }
+        write_back_runs(pages,cnt);
+
+        lock_acquire(&frame_lock);
+        for(i=0;i<cnt;i++){
+            struct kpage_t* page=pages[i];
+            struct frame* f=frame_of(page->kaddr);
+            uint32_t* pte=pte_of(page);
+
+            account_prefetch(page,*pte);
+            *pte&=~(uint32_t)PTE_P;
+            unlink_page(f,page);
+            page->vme->loaded_on_phys=false;
+            page->vme->cow=false;
+            if(--f->pin_cnt==0&&f->page==NULL)
+                release_frame(f);
+            free(page);
+        }
+        lock_release(&frame_lock);
+        invalidate_pagedir(cur->pagedir);
+        unmap_batch_cnt++;
+    }
+}
+
+/* Handles a write to VME, a writable page of the current process
+   that is mapped read-only because fork() left its frame shared.
+   The last process still sharing the frame simply gets write
+   access back; any other gets a copy.  Returns false if out of
+   memory. */
+bool frame_break_cow(struct vm_entry* vme){
+    struct thread* cur=thread_current();
+    struct kpage_t* page;
+    struct frame* f;
+    uint32_t* pte;
+    void* copy;
+
+    lock_acquire(&frame_lock);
+    pte=lookup_page(cur->pagedir,vme->vaddr,false);
+    if(pte==NULL||(*pte&PTE_P)==0){
+        /* Evicted meanwhile; the retried access faults it back. */
+        lock_release(&frame_lock);
+        return true;
+    }
+    f=frame_of(pte_get_page(*pte));
+    for(page=f->page;page->thread!=cur||page->vme!=vme;page=page->next_map)
+        ASSERT(page->next_map!=NULL);
+    if(f->page==page&&page->next_map==NULL){
+        *pte|=PTE_W;
+        invalidate_pagedir(cur->pagedir);
+        vme->cow=false;
+        lock_release(&frame_lock);
+        return true;
+    }
+    f->pin_cnt++;
+    lock_release(&frame_lock);
+
+    copy=frame_alloc(true);
+    if(copy!=NULL)
+        memcpy(copy,page->kaddr,PGSIZE);
+
+    lock_acquire(&frame_lock);
+    f->pin_cnt--;
+    if(copy==NULL){
+        lock_release(&frame_lock);
+        return false;
+    }
+    unlink_page(f,page);
+    list_remove(&page->elem);
+    pagedir_clear_page(cur->pagedir,vme->vaddr);
+    if(f->page==NULL&&f->pin_cnt==0)
+        release_frame(f);
+    page->kaddr=copy;
+    if(!pagedir_set_page(cur->pagedir,vme->vaddr,copy,true))
+        PANIC("page table vanished under a mapped page");
+    set_page(page);
+    vme->cow=false;
+    cow_copy_cnt++;
+    lock_release(&frame_lock);
+    return true;
+}
+
+/* Returns the first page mapping the frame at KADDR, or NULL.
+   Further mappings follow through next_map. */
+struct kpage_t* frame_lookup(void* kaddr){
+    return frame_of(kaddr)->page;
+}
+
+/* Keeps the frame at KADDR from being evicted or freed until
+   frame_unpin().  Caller must hold frame_lock. */
+void frame_pin(void* kaddr){
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    frame_of(kaddr)->pin_cnt++;
+}
+
+/* Drops a pin taken by frame_pin(), freeing the frame if its last
+   mapping went away meanwhile.  Caller must hold frame_lock. */
+void frame_unpin(void* kaddr){
+    struct frame* f=frame_of(kaddr);
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    ASSERT(f->pin_cnt>0);
+    if(--f->pin_cnt==0&&f->page==NULL)
+        release_frame(f);
+}
+
+void frame_print_stats(void){
+    printf("Frames: %s replacement, %lld evictions reclaimed %lld frames\n",
+           policy->name,eviction_cnt,evicted_cnt);
+    printf("Frames: %lld clean file pages dropped, %lld written back, "
+           "%lld swapped\n",dropped_cnt,written_cnt,swapped_cnt);
+    printf("Frames: %lld zero-page maps, %lld copied on write, "
+           "%lld shared frames copied\n",zero_map_cnt,zero_copy_cnt,cow_copy_cnt);
+    printf("Frames: %lld unmap batches, %lld write-back runs\n",
+           unmap_batch_cnt,written_run_cnt);
+}
+
+/* Counts a read fault served by zero_frame or, if COPIED, a write
+   that replaced such a mapping with a frame of its own. */
+void frame_count_zero_map(bool copied){
+    if(copied)
+        zero_copy_cnt++;
+    else
+        zero_map_cnt++;
+}
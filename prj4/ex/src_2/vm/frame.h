@@ -0,0 +1,68 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+#include "vm/page.h"
+#include "vm/pcache.h"
+
+/* One entry per physical page frame, indexed by frame number. */
+struct frame{
+    struct kpage_t* page;   // first mapping, NULL if not a user frame in use;
+                            // more mappings follow through next_map
+    int pin_cnt;            // never chosen for eviction while nonzero
+    int64_t last_use;       // WSClock: timer tick the page was last seen used
+    uint8_t age;            // aging: PTE_A samples, newest in the top bit
+    struct pcache_entry* cached; // page cache entry for this frame, or NULL
+    struct thread* evictor; // thread writing it out in evict(), pinned
+                            // meanwhile, or NULL
+};
+
+/* A page replacement policy.  Eviction sweeps the clock hand over
+   the user frames and asks KEEP about each resident, unpinned one;
+   frames it does not keep become victims.  BEGIN, if not NULL,
+   runs once before each sweep. */
+struct replacement_policy{
+    const char* name;
+    void (*begin)(void);
+    bool (*keep)(struct frame* f);
+};
+
+/* Results of frame_claim(). */
+enum frame_claim_result{
+    FRAME_SHARED,   // PAGE now maps the page cache's frame
+    FRAME_CLAIMED,  // PAGE's frame is the page cache's, to be filled
+    FRAME_PRIVATE,  // PAGE's frame is to be filled, outside the cache
+    FRAME_FAILED    // out of memory; PAGE's frame was freed
+};
+
+/* Protects the frame table, every process's kpage_list and the
+   loaded_on_phys, evicting and cow flags of resident pages.  Held
+   only for bookkeeping: evict() drops it while it writes pages
+   out. */
+extern struct lock frame_lock;
+
+/* A page of zeros, mapped read-only wherever a zero-fill page has
+   been read but not yet written. */
+extern void* zero_frame;
+
+void frame_init(void);
+bool frame_set_policy(const char* name);
+void frame_print_stats(void);
+void frame_count_zero_map(bool copied);
+void* frame_alloc(bool evict_ok);
+void frame_set_page(struct kpage_t* page);
+void frame_share(struct kpage_t* page);
+void frame_set_cached(void* kaddr,struct pcache_entry* e);
+bool frame_break_cow(struct vm_entry* vme);
+void frame_free(void* kaddr);
+void frame_unmap(struct mmap_file* mmap_file);
+void frame_wait_evicted(struct vm_entry* vme);
+struct thread* frame_evictor(void* kaddr);
+void frame_wait_io(void);
+enum frame_claim_result frame_claim(struct kpage_t* page);
+struct kpage_t* frame_lookup(void* kaddr);
+void frame_pin(void* kaddr);
+void frame_unpin(void* kaddr);
+
+#endif
@@ -1,7 +1,9 @@
 #include "page.h"
 #include "threads/pte.h"
 #include "threads/interrupt.h"
-struct hash lru_list;
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
 
 static unsigned vm_hash_func(const struct hash_elem* helem,void* aux UNUSED){
     struct vm_entry* vm_entry=hash_entry(helem,struct vm_entry,h_elem);
@@ -39,12 +41,28 @@ struct vm_entry* find_vme(void* vaddr){
     return hash_entry(hash_find(&cur->vm,&src.h_elem),struct vm_entry,h_elem);
 }
 
+/* Returns whether VME's page holds nothing but zeros until it is
+   first written: a segment page with nothing to read, or an
+   anonymous page that was never swapped out. */
+bool is_zero_fill(struct vm_entry* vme){
+    if(vme->type==VM_BIN)
+        return vme->read_bytes==0;
+    return vme->type==VM_ANON&&vme->swap_sector==(block_sector_t)NOT_IN_SWAP;
+}
+
 static void destroy_vme(struct hash_elem *e, void *aux UNUSED){
 
     struct vm_entry* vme=hash_entry(e,struct vm_entry,h_elem);
+    /* The zero frame is shared; keep pagedir_destroy() from
+       freeing it.  vm_destroy() flushes the TLB once for all. */
+    if(vme->zero_mapped)
+        *lookup_page(thread_current()->pagedir,vme->vaddr,false)&=~(uint32_t)PTE_P;
+    swap_free(vme);
     free(vme);
 }
 
+/* Frees every entry of VM, after frame_unmap() has taken down its
+   resident pages. */
 void vm_destroy(struct hash* vm){
     // struct hash_iterator h_iter;
     // hash_first(&h_iter,vm);
@@ -52,6 +70,7 @@ void vm_destroy(struct hash* vm){
     // struct file* file=list_entry(&h_iter.elem->list_elem,struct file,elem);
     // file_close(file);
     hash_destroy(vm,destroy_vme);
+    invalidate_pagedir(thread_current()->pagedir);
 }
 
 void all_mmap_destroy(struct list* mmap_list){
@@ -71,43 +90,22 @@ void all_mmap_destroy(struct list* mmap_list){
     }
 }
 
-struct list_elem* mmap_destroy(struct mmap_file* mmap_file,bool free_vm){
+/* Unmaps MMAP_FILE's pages, writing back those that were
+   written, frees their entries, closes the mapping's file and
+   takes it off the owner's mmap_list.  Returns the element that
+   followed it there. */
+struct list_elem* mmap_destroy(struct mmap_file* mmap_file,bool free_vm UNUSED){
     struct list_elem* iter;
     struct vm_entry* vm_iter;
     struct thread* cur=thread_current();
-    uint32_t* pte;
-    
+
+    frame_unmap(mmap_file);
     for(iter=list_begin(&mmap_file->vme_list);iter!=list_end(&mmap_file->vme_list);){
         vm_iter=list_entry(iter,struct vm_entry,mmap_elem);
-        
-        // hash_delete(&cur->vm,vm_iter);
         iter=list_remove(iter);
-
-        pte = lookup_page (cur->pagedir, vm_iter->vaddr, false);
-        // void* kaddr= pg_round_down(*pte);
-        // file_write_at(vm_iter->file,vm_iter->vaddr,vm_iter->read_bytes,vm_iter->offset);
-        if (pte != NULL && (*pte & PTE_P) != 0){
-            if(*pte&PTE_D){
-                // if(intr_get_level()==INTR_ON)
-                 file_write_at(vm_iter->file,vm_iter->vaddr,vm_iter->read_bytes,vm_iter->offset);
-                // else{
-                    // intr_set_level(INTR_ON);
-                    // file_write_at(vm_iter->file,pg_round_down(*pte),vm_iter->read_bytes,vm_iter->offset);
-                    // intr_set_level(INTR_OFF);
-                // }
-            }
-            *pte &= ~PTE_P;
-        }
-        // if(free_vm){
-
-            // free(vm_iter);
         delete_vme(&cur->vm,vm_iter);
         free(vm_iter);
-        // }
     }
-
-    
-    invalidate_pagedir (cur->pagedir);
+    file_close(mmap_file->file);
     return list_remove(&mmap_file->elem);
 }
-
@@ -20,6 +20,9 @@ struct vm_entry
     bool writable;
 
     bool loaded_on_phys;
+    bool zero_mapped; // loaded read-only from the shared zero_frame
+    bool cow; // loaded read-only from a frame shared by fork()
+    bool evicting; // its frame is being written out by evict()
     struct file* file;
 
     struct list_elem mmap_elem;
@@ -35,7 +38,8 @@ struct kpage_t{
     void* kaddr; // physcial
     struct vm_entry* vme;
     struct thread* thread;
-    struct list_elem lru_elem;
+    bool prefetched; // read around, not yet seen accessed
+    struct kpage_t* next_map; // next mapping of the same frame
     struct list_elem elem;
 };
 
@@ -52,8 +56,10 @@ inline void insert_vme(struct hash* vm, struct vm_entry* vme){
 }
 inline void delete_vme(struct hash* vm, struct vm_entry* vme);
 struct vm_entry* find_vme(void* vaddr);
+bool is_zero_fill(struct vm_entry* vme);
 void vm_destroy(struct hash* vm);
 
 struct list_elem* mmap_destroy(struct mmap_file* mmap_file, bool free_vm);
+void all_mmap_destroy(struct list* mmap_list);
 
 #endif
\ No newline at end of file
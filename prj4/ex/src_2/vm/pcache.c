@@ -0,0 +1,198 @@
+#include "pcache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "filesys/inode.h"
+#include "vm/frame.h"
+
+/* File pages held in frames, by inode and offset: read-only
+   executable pages and mmap pages.  A process that faults on such
+   a page maps the frame another process already read it into
+   instead of reading its own copy, and inode_read_at() and
+   inode_write_at() go through the frame too, so read() sees data
+   written through a mapping and a mapping sees data written by
+   write() without either being flushed first.
+
+   The frame's chain of mappings is its reference count: the entry
+   lives exactly as long as the frame, and frame.c removes it when
+   the last mapping goes or the frame is evicted.  Protected by
+   frame_lock. */
+static struct hash pcache;
+
+/* Statistics. */
+static long long cached_cnt;    /* Pages entered into the cache. */
+static long long shared_cnt;    /* Faults served from the cache. */
+static long long read_cnt;      /* read() calls served from a frame. */
+static long long around_cached_cnt; /* Pages mapped around a fault from here. */
+static long long around_read_cnt;   /* ...and read from the file instead. */
+
+static unsigned pcache_hash(const struct hash_elem* e_,void* aux UNUSED){
+    const struct pcache_entry* e=hash_entry(e_,struct pcache_entry,elem);
+    return hash_int(e->inumber)^hash_int(e->offset);
+}
+
+static bool pcache_less(const struct hash_elem* a_,const struct hash_elem* b_,void* aux UNUSED){
+    const struct pcache_entry* a=hash_entry(a_,struct pcache_entry,elem);
+    const struct pcache_entry* b=hash_entry(b_,struct pcache_entry,elem);
+    if(a->inumber!=b->inumber)
+        return a->inumber<b->inumber;
+    return a->offset<b->offset;
+}
+
+void pcache_init(void){
+    hash_init(&pcache,pcache_hash,pcache_less,NULL);
+}
+
+/* Returns the entry for the page of INODE that starts at OFFSET,
+   or NULL.  Caller must hold frame_lock. */
+static struct pcache_entry* find(struct inode* inode,off_t offset){
+    struct pcache_entry key;
+    struct hash_elem* e;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    key.inumber=inode_get_inumber(inode);
+    key.offset=offset;
+    e=hash_find(&pcache,&key.elem);
+    return e!=NULL?hash_entry(e,struct pcache_entry,elem):NULL;
+}
+
+/* Claims the page cache entry for VME's page for KADDR, a frame
+   fresh from frame_alloc(), and returns KADDR; the caller then
+   fills the frame and calls pcache_loaded().  If another frame
+   already holds the page, waits for it to be filled and returns
+   it instead, so that at most one frame ever holds a page of a
+   file.  A frame is only shared between pages of the same type and
+   length, so that an mmap of a running program never writes into
+   its text; returns NULL for a page that cannot share the frame
+   holding it, or if out of memory, and KADDR then stays private.
+   Caller must hold frame_lock. */
+void* pcache_claim(struct vm_entry* vme,void* kaddr){
+    struct inode* inode=file_get_inode(vme->file);
+    struct pcache_entry* e;
+
+    for(;;){
+        e=find(inode,vme->offset);
+        if(e==NULL)
+            break;
+        if(e->type!=vme->type||e->read_bytes!=vme->read_bytes)
+            return NULL;
+        if(!e->loading&&frame_evictor(e->kaddr)==NULL){
+            shared_cnt++;
+            return e->kaddr;
+        }
+        /* Filled, given up or evicted, the entry may be gone
+           when this returns. */
+        frame_wait_io();
+    }
+
+    e=malloc(sizeof *e);
+    if(e==NULL)
+        return NULL;
+    e->inumber=inode_get_inumber(inode);
+    e->offset=vme->offset;
+    e->read_bytes=vme->read_bytes;
+    e->type=vme->type;
+    e->kaddr=kaddr;
+    e->loading=true;
+    hash_insert(&pcache,&e->elem);
+    frame_set_cached(kaddr,e);
+    cached_cnt++;
+    return kaddr;
+}
+
+/* Marks E's frame as filled.  Caller must hold frame_lock and
+   wake the threads waiting for it. */
+void pcache_loaded(struct pcache_entry* e){
+    ASSERT(e->loading);
+    e->loading=false;
+}
+
+/* Forgets E, whose frame is being freed.  Caller must hold
+   frame_lock. */
+void pcache_remove(struct pcache_entry* e){
+    hash_delete(&pcache,&e->elem);
+    free(e);
+}
+
+/* Copies between BUFFER and the cached copy of INODE's bytes at
+   OFFSET, up to SIZE bytes and no further than the end of the
+   page's file data; into the frame if WRITE.  Returns the number
+   of bytes copied, 0 if the page is not cached.
+
+   The frame is pinned for the copy, outside frame_lock, since
+   BUFFER may be a user page that faults.  A frame still being
+   filled or being evicted is waited out, so that a read sees
+   neither a half-filled frame nor a disk that evict() has not yet
+   brought up to date; but not by the thread filling or evicting
+   it, which is reading into the frame or writing it back. */
+static off_t copy(struct inode* inode,void* buffer,off_t size,off_t offset,bool write){
+    off_t page_ofs=offset-offset%PGSIZE;
+    struct pcache_entry* e;
+    uint8_t* data;
+    void* kaddr;
+    off_t n;
+
+    ASSERT(!lock_held_by_current_thread(&frame_lock));
+    lock_acquire(&frame_lock);
+    for(;;){
+        e=find(inode,page_ofs);
+        if(e==NULL||offset-page_ofs>=(off_t)e->read_bytes){
+            lock_release(&frame_lock);
+            return 0;
+        }
+        kaddr=e->kaddr;
+        data=(uint8_t*)kaddr+(offset-page_ofs);
+        n=(off_t)e->read_bytes-(offset-page_ofs);
+        if(n>size)
+            n=size;
+        /* Filling the frame from its file, or writing it back. */
+        if(data==buffer||frame_evictor(kaddr)==thread_current()){
+            lock_release(&frame_lock);
+            return write?n:0;
+        }
+        if(!e->loading&&frame_evictor(kaddr)==NULL)
+            break;
+        frame_wait_io();
+    }
+    frame_pin(kaddr);
+    lock_release(&frame_lock);
+    memcpy(write?data:buffer,write?buffer:data,n);
+    lock_acquire(&frame_lock);
+    frame_unpin(kaddr);
+    lock_release(&frame_lock);
+    return n;
+}
+
+/* Reads up to SIZE bytes of INODE at OFFSET into BUFFER from a
+   frame holding them, and returns the number read.  Returns 0 if
+   the data is not in a frame and must be read from disk. */
+off_t pcache_read(struct inode* inode,void* buffer,off_t size,off_t offset){
+    off_t n=copy(inode,buffer,size,offset,false);
+    if(n>0)
+        read_cnt++;
+    return n;
+}
+
+/* Copies SIZE bytes being written to INODE at OFFSET into the
+   frame holding them, if any, so that mappings see them. */
+void pcache_write(struct inode* inode,const void* buffer,off_t size,off_t offset){
+    copy(inode,(void*)buffer,size,offset,true);
+}
+
+/* Counts a page mapped around a fault, from a cached frame if
+   CACHED and read from its file otherwise. */
+void pcache_count_around(bool cached){
+    if(cached)
+        around_cached_cnt++;
+    else
+        around_read_cnt++;
+}
+
+void pcache_print_stats(void){
+    printf("Page cache: %lld pages cached, %lld faults shared a cached page, "
+           "%lld reads served from frames\n",cached_cnt,shared_cnt,read_cnt);
+    printf("Page cache: %lld pages mapped around faults from the cache, "
+           "%lld read\n",around_cached_cnt,around_read_cnt);
+}
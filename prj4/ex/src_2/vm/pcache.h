@@ -0,0 +1,33 @@
+#ifndef VM_PCACHE_H
+#define VM_PCACHE_H
+#include <hash.h>
+#include <stddef.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+#include "vm/page.h"
+
+struct inode;
+
+/* A frame holding the page of a file that starts at OFFSET, with
+   READ_BYTES bytes from the file and zeros after them, mapped as
+   TYPE (VM_BIN or VM_FILE). */
+struct pcache_entry{
+    struct hash_elem elem;
+    block_sector_t inumber;     // inode the page was read from
+    off_t offset;               // page aligned
+    size_t read_bytes;
+    uint8_t type;
+    void* kaddr;
+    bool loading;               // claimed, frame still being filled
+};
+
+void pcache_init(void);
+void* pcache_claim(struct vm_entry* vme,void* kaddr);
+void pcache_loaded(struct pcache_entry* e);
+void pcache_remove(struct pcache_entry* e);
+off_t pcache_read(struct inode* inode,void* buffer,off_t size,off_t offset);
+void pcache_write(struct inode* inode,const void* buffer,off_t size,off_t offset);
+void pcache_count_around(bool cached);
+void pcache_print_stats(void);
+
+#endif
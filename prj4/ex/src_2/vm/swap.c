@@ -1,52 +1,178 @@
 #include "swap.h"
 #include "devices/block.h"
-#include <bitmap.h>
 #include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
 static struct block* swap_device;
-static struct bitmap* swap_free_map;
 static struct lock swap_lock;
-void swap_out(struct kpage_t* page){
-    int i;
 
-    lock_acquire(&swap_lock);    
-    block_sector_t sector=bitmap_scan_and_flip(swap_free_map,0,SECTOR_PER_PAGE,false);
-    for(i=0;i<SECTOR_PER_PAGE;i++){
-        block_write(swap_device,(sector+i),page->kaddr + (i*BLOCK_SECTOR_SIZE)); 
+/* Swap space is handed out in page-sized slots; slot S covers
+   sectors S*SECTOR_PER_PAGE and up.  Slots at or above slot_top
+   have never been used and are taken in order, which keeps pages
+   evicted together next to each other.  Slots released below
+   slot_top are pushed on free_slots and reused first-in last-out.
+   Both ends make allocating and freeing a slot O(1).  A slot
+   holding a page that fork() left shared is referenced by every
+   sharer and released with the last reference. */
+static size_t slot_cnt;             /* Slots on the swap device. */
+static size_t slot_top;             /* First never-used slot. */
+static size_t *free_slots;          /* Stack of released slots. */
+static size_t free_slot_cnt;        /* Slots on the stack. */
+static uint8_t *slot_refs;          /* References to each slot. */
+
+/* Statistics. */
+static long long swap_out_cnt;      /* Pages written to swap. */
+static long long swap_in_cnt;       /* Pages read on a fault. */
+static long long prefetch_cnt;      /* Pages read around a fault. */
+static long long prefetch_hit_cnt;  /* Of those, pages used later. */
+
+/* Takes a slot off the free stack or, failing that, the next
+   never-used slot, and returns its first sector.  Panics if swap
+   is full.  Caller must hold swap_lock. */
+static block_sector_t slot_alloc(void){
+    size_t slot;
+    if(free_slot_cnt>0)
+        slot=free_slots[--free_slot_cnt];
+    else if(slot_top<slot_cnt)
+        slot=slot_top++;
+    else
+        PANIC("swap device is full");
+    ASSERT(slot_refs[slot]==0);
+    slot_refs[slot]=1;
+    return slot*SECTOR_PER_PAGE;
+}
+
+/* Drops a reference to the slot starting at SECTOR, releasing it
+   with the last one.  Caller must hold swap_lock. */
+static void slot_free(block_sector_t sector){
+    size_t slot=sector/SECTOR_PER_PAGE;
+    ASSERT(slot_refs[slot]>0);
+    if(--slot_refs[slot]==0)
+        free_slots[free_slot_cnt++]=slot;
+}
+
+/* Adds a reference to the slot starting at SECTOR, for one more
+   page that has the same contents. */
+void swap_dup(block_sector_t sector){
+    size_t slot=sector/SECTOR_PER_PAGE;
+    lock_acquire(&swap_lock);
+    ASSERT(slot_refs[slot]>0&&slot_refs[slot]<UINT8_MAX);
+    slot_refs[slot]++;
+    lock_release(&swap_lock);
+}
+
+/* Writes the CNT pages in PAGES to swap.  The pages get adjacent
+   slots when they can, and all the writes are
+   queued before waiting for any, so the block layer sends a
+   cluster to the disk as one transfer. */
+void swap_out_batch(struct kpage_t** pages,size_t cnt){
+    struct block_request reqs[SWAP_BATCH_MAX];
+    size_t i;
+
+    ASSERT(cnt<=SWAP_BATCH_MAX);
+    lock_acquire(&swap_lock);
+    if(free_slot_cnt==0){
+        for(i=0;i<cnt;i++)
+            pages[i]->vme->swap_sector=slot_alloc();
+    }
+    else{
+        /* swap_in_batch() releases runs in ascending order, so
+           filling PAGES from the end gets a run back the same way. */
+        for(i=cnt;i-->0;)
+            pages[i]->vme->swap_sector=slot_alloc();
     }
     lock_release(&swap_lock);
-    page->vme->swap_sector=sector;
 
+    for(i=0;i<cnt;i++){
+        block_request_init(&reqs[i],true,pages[i]->vme->swap_sector,
+                           SECTOR_PER_PAGE,pages[i]->kaddr);
+        block_submit(swap_device,&reqs[i]);
+    }
+    for(i=0;i<cnt;i++)
+        block_wait(&reqs[i]);
+    swap_out_cnt+=cnt;
+}
+
+void swap_out(struct kpage_t* page){
+    swap_out_batch(&page,1);
 }
 void swap_in(struct kpage_t* page){
-    int i;
     // ASSERT(page->vme->swap_sector!=-1);
     EXPECT_NE(page->vme->swap_sector,-1);
-    lock_acquire(&swap_lock);
     memset(page->kaddr,0,PGSIZE);
-    bitmap_set_multiple(swap_free_map,page->vme->swap_sector,SECTOR_PER_PAGE,false);
-    for(i=0;i<SECTOR_PER_PAGE;i++){
-        block_read(swap_device, page->vme->swap_sector+i ,page->kaddr + (i*BLOCK_SECTOR_SIZE));
-    }
+    block_read_multiple(swap_device,page->vme->swap_sector,SECTOR_PER_PAGE,page->kaddr);
+    lock_acquire(&swap_lock);
+    slot_free(page->vme->swap_sector);
+    swap_in_cnt++;
     lock_release(&swap_lock);
     page->vme->swap_sector=NOT_IN_SWAP;
 }
 
-void swap_free(struct kpage_t* page){
-    if(page->vme->swap_sector==NOT_IN_SWAP||page->vme->loaded_on_phys==true){
+/* Reads the CNT pages in PAGES back from swap for read-around and
+   releases their slots.  Slots next to each other are fetched in
+   one transfer by the block request queue. */
+void swap_in_batch(struct kpage_t** pages,size_t cnt){
+    struct block_request reqs[2*SWAP_BATCH_MAX];
+    size_t i;
+
+    ASSERT(cnt<=2*SWAP_BATCH_MAX);
+    /* Sort by slot so that the slots are released in order. */
+    for(i=1;i<cnt;i++){
+        struct kpage_t* page=pages[i];
+        size_t j;
+        for(j=i;j>0&&pages[j-1]->vme->swap_sector>page->vme->swap_sector;j--)
+            pages[j]=pages[j-1];
+        pages[j]=page;
+    }
+    for(i=0;i<cnt;i++){
+        block_request_init(&reqs[i],false,pages[i]->vme->swap_sector,
+                           SECTOR_PER_PAGE,pages[i]->kaddr);
+        block_submit(swap_device,&reqs[i]);
+    }
+    for(i=0;i<cnt;i++)
+        block_wait(&reqs[i]);
+
+    lock_acquire(&swap_lock);
+    for(i=0;i<cnt;i++){
+        slot_free(pages[i]->vme->swap_sector);
+        pages[i]->vme->swap_sector=NOT_IN_SWAP;
+    }
+    prefetch_cnt+=cnt;
+    lock_release(&swap_lock);
+}
+
+/* Records that a page brought in by swap_in_batch() was used. */
+void swap_count_prefetch_hit(void){
+    prefetch_hit_cnt++;
+}
+
+void swap_print_stats(void){
+    printf("Swap: %lld pages out, %lld in, %lld read around (%lld used)\n",
+           swap_out_cnt,swap_in_cnt,prefetch_cnt,prefetch_hit_cnt);
+}
+
+/* Releases VME's swap slot, if it has one, when VME goes away. */
+void swap_free(struct vm_entry* vme){
+    if(vme->swap_sector==(block_sector_t)NOT_IN_SWAP||vme->loaded_on_phys==true){
         return;
     }
     lock_acquire(&swap_lock);
-    bitmap_set_multiple(swap_free_map,page->vme->swap_sector,SECTOR_PER_PAGE,false);
+    slot_free(vme->swap_sector);
     lock_release(&swap_lock);
+    vme->swap_sector=NOT_IN_SWAP;
 }
 
 void swap_init(void){
     swap_device=block_get_role(BLOCK_SWAP);
     if (swap_device == NULL)
         PANIC ("No file swap device found, can't initialize file swap.");
-    swap_free_map=bitmap_create(block_size(swap_device));
-    bitmap_set_all(swap_free_map,false);
-    if (swap_free_map == NULL)
-        PANIC ("bitmap creation failed--swap device is too large");
+    slot_cnt=block_size(swap_device)/SECTOR_PER_PAGE;
+    free_slots=palloc_get_multiple(0,DIV_ROUND_UP(slot_cnt*sizeof *free_slots,PGSIZE));
+    slot_refs=palloc_get_multiple(PAL_ZERO,DIV_ROUND_UP(slot_cnt,PGSIZE));
+    if (free_slots == NULL || slot_refs == NULL)
+        PANIC ("slot table creation failed--swap device is too large");
+    slot_top=0;
+    free_slot_cnt=0;
     lock_init(&swap_lock);
-}
\ No newline at end of file
+}
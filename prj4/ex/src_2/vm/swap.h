@@ -5,11 +5,18 @@
 #define SECTOR_PER_PAGE (PGSIZE)/(BLOCK_SECTOR_SIZE)
 
 #define NOT_IN_SWAP -1
-void swap_free(struct kpage_t* page);
+/* Most pages written by one swap_out_batch() call. */
+#define SWAP_BATCH_MAX 8
+void swap_free(struct vm_entry* vme);
+void swap_dup(block_sector_t sector);
 
 void swap_init(void);
 void swap_in(struct kpage_t* page);
 void swap_out(struct kpage_t* page);
+void swap_out_batch(struct kpage_t** pages,size_t cnt);
+void swap_in_batch(struct kpage_t** pages,size_t cnt);
+void swap_count_prefetch_hit(void);
+void swap_print_stats(void);
 
 
 #endif
\ No newline at end of file
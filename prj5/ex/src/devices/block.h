@@ -3,6 +3,9 @@
 
 #include <stddef.h>
 #include <inttypes.h>
+#include <block-stats.h>
+#include <list.h>
+#include "threads/synch.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -53,11 +56,45 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, size_t cnt,
+                          void *);
+void block_write_multiple (struct block *, block_sector_t, size_t cnt,
+                           const void *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* Asynchronous requests.
+
+   A request is queued on its device and carried out later by a
+   per-device thread, so the submitter can keep running.  Each
+   device's queue is kept in sector order and serviced C-LOOK
+   style, and queued requests for adjacent sectors in the same
+   direction are carried out as a single transfer. */
+struct block_request
+  {
+    struct list_elem elem;              /* Element in device queue. */
+    bool write;                         /* Write instead of read? */
+    block_sector_t sector;              /* First sector. */
+    size_t cnt;                         /* Number of sectors. */
+    void *buffer;                       /* CNT * BLOCK_SECTOR_SIZE bytes. */
+
+    /* If non-null, called by the device thread once the transfer
+       is done, instead of waking up block_wait(). */
+    void (*complete) (struct block_request *);
+    void *aux;                          /* For COMPLETE's use. */
+
+    struct semaphore done;              /* Up'd when done. */
+    uint64_t submit_time;               /* Cycle count at submission. */
+  };
+
+void block_request_init (struct block_request *, bool write,
+                         block_sector_t, size_t cnt, void *buffer);
+void block_submit (struct block *, struct block_request *);
+void block_wait (struct block_request *);
+
 /* Statistics. */
 void block_print_stats (void);
+void block_get_stats (struct block *, struct block_stats *);
 
 /* Lower-level interface to block device drivers. */
 
@@ -65,6 +102,14 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Optional.  Transfer CNT consecutive sectors with as few
+       device commands as possible.  If null, the block layer
+       calls read or write once per sector instead. */
+    void (*read_multiple) (void *aux, block_sector_t, size_t cnt,
+                           void *buffer);
+    void (*write_multiple) (void *aux, block_sector_t, size_t cnt,
+                            const void *buffer);
   };
 
 struct block *block_register (const char *name, enum block_type,
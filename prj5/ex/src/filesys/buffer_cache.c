@@ -1,23 +1,153 @@
 #include "filesys/buffer_cache.h"
+#include <hash.h>
+#include "devices/timer.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include <round.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <debug.h>
 
-#define BUFFER_CACHE_ENTRIES 64
+/* Synchronization.
 
-static struct buffer_cache_entry buffer_head[BUFFER_CACHE_ENTRIES];
-static struct buffer_cache_entry *clock_hand;
+   The sector index, the clock hand and the bookkeeping fields of
+   every entry (valid_bit, disk_sector, busy, reader_cnt and the
+   index linkage) are protected by buffer_cache_lock.  It is only
+   held for a few instructions at a time and never across I/O or
+   a copy of sector data, so a cache hit holds it just long enough
+   to probe the index and bump reader_cnt, then copies the data
+   without it.
+
+   An entry is then used in one of two modes.  Any number of
+   threads may hold it shared (reader_cnt > 0) to copy data out of
+   it or write it back to disk.  One thread at a time may hold it
+   exclusively (busy) to fill it from disk, clean it before
+   eviction, or modify it.  bc_select_victim() only picks entries
+   that nobody holds, so an entry cannot be re-keyed under a
+   concurrent user; a lookup that raced with a re-key notices the
+   new disk_sector when it wakes up and starts over.  Threads
+   waiting for an entry to be released wait on its RELEASED
+   condition; threads waiting for any entry to be released wait on
+   entry_released.
+
+   Read-ahead and write-behind do not wait for the disk one sector
+   at a time.  They submit each entry's transfer to the block
+   layer's request queue and keep holding the entry until it
+   completes: a read-ahead fill holds it exclusively and is
+   released by bc_fill_done() in the device thread, and a
+   write-behind pass holds its entries shared until every write
+   of the pass is done. */
+
+/* Timer ticks between write-behind passes. */
+#define BC_FLUSH_INTERVAL TIMER_FREQ
+
+/* Maximum number of entries bc_select_victim() examines per
+   call, so that a large cache does not hold buffer_cache_lock
+   for long. */
+#define BC_VICTIM_SCAN 128
+
+/* Maximum number of queued read-ahead requests.  Requests made
+   while the queue is full are dropped. */
+#define BC_READ_AHEAD_QUEUE 64
+
+/* How an entry is held. */
+enum bc_mode
+{
+    BC_SHARED,   /* Data is read, not changed. */
+    BC_EXCLUSIVE /* Data or sector may change. */
+};
+
+/* What bc_get_entry() does if the sector is not cached. */
+enum bc_fill
+{
+    BC_NO_FILL,   /* Return a null pointer. */
+    BC_FILL,      /* Read the sector into a victim entry. */
+    BC_FILL_ASYNC /* Start reading it, return a null pointer. */
+};
+
+/* Number of sectors cached.  Set by the -bc kernel command-line
+   option before bc_init() runs. */
+size_t buffer_cache_entries = BUFFER_CACHE_DEFAULT_ENTRIES;
+
+static struct buffer_cache_entry *buffer_head; /* buffer_cache_entries entries. */
+static uint8_t *buffer_data;                   /* Sector data, in kernel pages. */
+static size_t clock_hand;
+
+/* Protects the index and the entries' bookkeeping.  See the
+   synchronization comment above. */
 static struct lock buffer_cache_lock;
 
+/* Signaled whenever some entry becomes free for eviction. */
+static struct condition entry_released;
+
+/* Maps disk_sector to the valid entry caching it.  A fixed array
+   of buckets, so updates never allocate. */
+static struct list *buffer_index;
+static size_t bucket_cnt;
+
+/* Statistics. */
+static unsigned long long hit_cnt;  /* Lookups that found the sector cached. */
+static unsigned long long miss_cnt; /* Lookups that had to read the disk. */
+
+/* Scratch space for one write-behind pass. */
+static block_sector_t *flush_sectors;
+static struct buffer_cache_entry **flush_entries;
+
+/* Sectors waiting to be read ahead, as a ring buffer protected by
+   read_ahead_lock.  read_ahead_cnt counts queued sectors. */
+static block_sector_t read_ahead_queue[BC_READ_AHEAD_QUEUE];
+static size_t read_ahead_head, read_ahead_tail;
+static struct lock read_ahead_lock;
+static struct semaphore read_ahead_cnt;
+
+static struct buffer_cache_entry *bc_get_entry(block_sector_t, enum bc_mode, enum bc_fill);
+static void bc_fill_done(struct block_request *);
+static void bc_put_entry(struct buffer_cache_entry *, enum bc_mode);
+static bool bc_cached(block_sector_t);
+static struct list *index_bucket(block_sector_t);
+static thread_func bc_flusher;
+static thread_func bc_read_ahead_worker;
+static void bc_write_behind(void);
+static int sector_compare(const void *, const void *);
+
 void bc_init(void)
 {
-    //lock_init(&buffer_cache_lock);
-    for (int i = 0; i != BUFFER_CACHE_ENTRIES; i++)
+    ASSERT(buffer_cache_entries > 0);
+
+    for (bucket_cnt = 1; bucket_cnt < buffer_cache_entries; bucket_cnt *= 2)
+        continue;
+
+    size_t data_pages = DIV_ROUND_UP(buffer_cache_entries * BLOCK_SECTOR_SIZE, PGSIZE);
+    buffer_head = calloc(buffer_cache_entries, sizeof *buffer_head);
+    buffer_data = palloc_get_multiple(0, data_pages);
+    buffer_index = malloc(bucket_cnt * sizeof *buffer_index);
+    flush_sectors = malloc(buffer_cache_entries * sizeof *flush_sectors);
+    flush_entries = malloc(buffer_cache_entries * sizeof *flush_entries);
+    if (buffer_head == NULL || buffer_data == NULL || buffer_index == NULL || flush_sectors == NULL || flush_entries == NULL)
+        PANIC("buffer cache of %zu sectors does not fit in the kernel pool",
+              buffer_cache_entries);
+
+    lock_init(&buffer_cache_lock);
+    cond_init(&entry_released);
+    for (size_t i = 0; i != bucket_cnt; i++)
+        list_init(&buffer_index[i]);
+    for (size_t i = 0; i != buffer_cache_entries; i++)
     {
-        memset(&buffer_head[i], 0, sizeof(struct buffer_cache_entry));
-        lock_init(&(&buffer_head[i])->lock);
+        cond_init(&buffer_head[i].released);
+        buffer_head[i].buffer = buffer_data + i * BLOCK_SECTOR_SIZE;
     }
-    clock_hand = buffer_head;
+    clock_hand = 0;
+    hit_cnt = miss_cnt = 0;
+
+    lock_init(&read_ahead_lock);
+    sema_init(&read_ahead_cnt, 0);
+    read_ahead_head = read_ahead_tail = 0;
+
+    thread_create("bc_flusher", PRI_DEFAULT, bc_flusher, NULL);
+    thread_create("bc_read_ahead", PRI_DEFAULT, bc_read_ahead_worker, NULL);
 }
 
 void bc_term(void)
@@ -27,66 +157,181 @@ void bc_term(void)
 
 bool bc_read(block_sector_t sector_idx, void *buffer, off_t bytes_read, int chunk_size, int sector_ofs)
 {
-    /* sector_idx를 buffer_head에서 검색 (bc_lookup 함수 이용) */
-    /* 검색 결과가 없을 경우, 디스크 블록을 캐싱 할 buffer entry의 buffer_head를 구함 (bc_select_victim 함수 이용) */
-    /* block_read 함수를 이용해, 디스크 블록 데이터를 buffer cache 로 read */
+    /* sector_idx를 캐싱하는 entry를 공유 모드로 구함 (bc_get_entry 함수 이용) */
     /* memcpy 함수를 통해, buffer에 디스크 블록 데이터를 복사 */
     /* buffer_head의 clock bit을 setting */
 
-    struct buffer_cache_entry *cur = bc_lookup(sector_idx);
-
-    if (cur == NULL)
-    {
-        cur = bc_select_victim();
-        bc_flush_entry(cur);
-        cur->valid_bit = true;
-        cur->dirty_bit = false;
-        cur->disk_sector = sector_idx;
-        block_read(fs_device, sector_idx, cur->buffer);
-    }
+    struct buffer_cache_entry *cur = bc_get_entry(sector_idx, BC_SHARED, BC_FILL);
 
     cur->reference_bit = true;
     memcpy(buffer + bytes_read, cur->buffer + sector_ofs, chunk_size);
-    lock_release(&cur->lock);
+    bc_put_entry(cur, BC_SHARED);
     return true;
 }
 
 bool bc_write(block_sector_t sector_idx, void *buffer, off_t offset, int chunk_size, int sector_ofs)
 {
-    /* sector_idx를 buffer_head에서 검색하여 buffer에 복사(구현)*/
-    /* update buffer_head (구현) */
+    /* sector_idx를 캐싱하는 entry를 배타 모드로 구하여 buffer를 복사 */
+    /* update buffer_head */
 
-    struct buffer_cache_entry *cur = bc_lookup(sector_idx);
-
-    if (cur == NULL)
-    {
-        cur = bc_select_victim();
-        bc_flush_entry(cur);
-        cur->valid_bit = true;
-        cur->disk_sector = sector_idx;
-        block_read(fs_device, sector_idx, cur->buffer);
-    }
+    struct buffer_cache_entry *cur = bc_get_entry(sector_idx, BC_EXCLUSIVE, BC_FILL);
 
     cur->reference_bit = true;
     cur->dirty_bit = true;
     memcpy(cur->buffer + sector_ofs, buffer + offset, chunk_size);
-    lock_release(&cur->lock);
+    bc_put_entry(cur, BC_EXCLUSIVE);
     return true;
 }
 
-struct buffer_cache_entry *bc_lookup(block_sector_t sector)
+/* Returns the entry caching SECTOR, held in MODE.  If SECTOR is
+   not cached, reads it into a victim entry first if FILL is
+   BC_FILL, or returns a null pointer if FILL is BC_NO_FILL.
+   With BC_FILL_ASYNC, only makes sure SECTOR is cached or being
+   read and always returns a null pointer. */
+static struct buffer_cache_entry *
+bc_get_entry(block_sector_t sector, enum bc_mode mode, enum bc_fill fill)
 {
-    /* buffe_head를 순회하며, 전달받은 sector 값과 동일한 sector 값을 갖는 buffer cache entry가 있는지 확인 */
-    /* 성공 : 찾은 buffer_head 반환, 실패 : NULL */
+    struct buffer_cache_entry *cur;
 
-    for (int i = 0; i < BUFFER_CACHE_ENTRIES; i++)
+    lock_acquire(&buffer_cache_lock);
+    for (;;)
     {
+        cur = bc_lookup(sector);
+        if (cur != NULL && fill == BC_FILL_ASYNC)
+        {
+            cur = NULL;
+            break;
+        }
+        if (cur != NULL)
+        {
+            if (cur->busy || (mode == BC_EXCLUSIVE && cur->reader_cnt > 0))
+            {
+                /* The entry may be re-keyed while we sleep, so
+                   look SECTOR up again afterward. */
+                cond_wait(&cur->released, &buffer_cache_lock);
+                continue;
+            }
+            if (mode == BC_SHARED)
+                cur->reader_cnt++;
+            else
+                cur->busy = true;
+            /* BC_NO_FILL lookups come from background flushing,
+               not from file system reads and writes. */
+            if (fill != BC_NO_FILL)
+                hit_cnt++;
+            break;
+        }
+        if (fill == BC_NO_FILL)
+            break;
+
+        cur = bc_select_victim();
+        if (cur == NULL)
+        {
+            /* Every entry looked at is in use.  Let one of them
+               be released. */
+            cond_wait(&entry_released, &buffer_cache_lock);
+            continue;
+        }
+        if (cur->valid_bit && cur->dirty_bit)
+        {
+            /* Clean the victim, then start over: SECTOR may have
+               been cached by someone else in the meantime. */
+            cur->busy = true;
+            lock_release(&buffer_cache_lock);
+            bc_flush_entry(cur);
+            bc_put_entry(cur, BC_EXCLUSIVE);
+            lock_acquire(&buffer_cache_lock);
+            continue;
+        }
+
+        /* Re-key the clean victim.  Concurrent lookups of SECTOR
+           find it busy and wait until the read below completes. */
+        if (cur->valid_bit)
+            list_remove(&cur->index_elem);
+        cur->valid_bit = true;
+        cur->dirty_bit = false;
+        cur->disk_sector = sector;
+        cur->busy = true;
+        list_push_front(index_bucket(sector), &cur->index_elem);
+        miss_cnt++;
+        lock_release(&buffer_cache_lock);
 
-        if (buffer_head[i].valid_bit && buffer_head[i].disk_sector == sector)
+        if (fill == BC_FILL_ASYNC)
         {
-            lock_acquire(&(&buffer_head[i])->lock);
-            return &buffer_head[i];
+            /* bc_fill_done() releases the entry. */
+            cur->reference_bit = true;
+            block_request_init(&cur->io, false, sector, 1, cur->buffer);
+            cur->io.complete = bc_fill_done;
+            cur->io.aux = cur;
+            block_submit(fs_device, &cur->io);
+            return NULL;
         }
+
+        block_read(fs_device, sector, cur->buffer);
+        if (mode == BC_SHARED)
+        {
+            /* Downgrade to shared, letting waiting readers in. */
+            lock_acquire(&buffer_cache_lock);
+            cur->reader_cnt++;
+            lock_release(&buffer_cache_lock);
+            bc_put_entry(cur, BC_EXCLUSIVE);
+        }
+        return cur;
+    }
+
+    lock_release(&buffer_cache_lock);
+    return cur;
+}
+
+/* Completes an asynchronous fill started by bc_get_entry(). */
+static void
+bc_fill_done(struct block_request *r)
+{
+    bc_put_entry(r->aux, BC_EXCLUSIVE);
+}
+
+/* Releases CUR, which the caller holds in MODE, and wakes up any
+   threads that were waiting for it. */
+static void
+bc_put_entry(struct buffer_cache_entry *cur, enum bc_mode mode)
+{
+    lock_acquire(&buffer_cache_lock);
+
+    if (mode == BC_SHARED)
+    {
+        ASSERT(cur->reader_cnt > 0);
+        cur->reader_cnt--;
+    }
+    else
+    {
+        ASSERT(cur->busy);
+        cur->busy = false;
+    }
+
+    if (cur->reader_cnt == 0 || mode == BC_EXCLUSIVE)
+        cond_broadcast(&cur->released, &buffer_cache_lock);
+    if (cur->reader_cnt == 0 && !cur->busy)
+        cond_broadcast(&entry_released, &buffer_cache_lock);
+
+    lock_release(&buffer_cache_lock);
+}
+
+struct buffer_cache_entry *bc_lookup(block_sector_t sector)
+{
+    /* buffer_index에서 전달받은 sector 값과 동일한 sector 값을 갖는 buffer cache entry를 검색 */
+    /* buffer_cache_lock을 잡은 상태에서 호출해야 하며, entry를 점유하지는 않음 */
+    /* 성공 : 찾은 buffer_head 반환, 실패 : NULL */
+
+    struct list *bucket = index_bucket(sector);
+    struct list_elem *e;
+
+    ASSERT(lock_held_by_current_thread(&buffer_cache_lock));
+
+    for (e = list_begin(bucket); e != list_end(bucket); e = list_next(e))
+    {
+        struct buffer_cache_entry *cur = list_entry(e, struct buffer_cache_entry, index_elem);
+        if (cur->disk_sector == sector)
+            return cur;
     }
     return NULL;
 }
@@ -95,38 +340,39 @@ struct buffer_cache_entry *bc_select_victim(void)
 {
     /* clock 알고리즘을 사용하여 victim entry를 선택 */
     /* buffer_head 전역변수를 순회하며 clock_bit 변수를 검사 */
-    /* 선택된 victim entry가 dirty일 경우, 디스크로 flush */
-    /* victim entry에 해당하는 buffer_head 값 update */
-    /* victim entry를 return */
-    int count = 0;
-    int idx = (clock_hand - buffer_head) / sizeof(struct buffer_cache_entry);
+    /* 다른 thread가 사용 중인 entry는 건너뜀 */
+    /* 최대 BC_VICTIM_SCAN개까지만 검사하고, clock bit이 꺼진 entry가 없으면
+       그 중 처음 본 사용 중이 아닌 entry를, 그것도 없으면 NULL 반환 */
+
+    struct buffer_cache_entry *unheld = NULL;
+    size_t scan = 2 * buffer_cache_entries;
 
-    if (idx == BUFFER_CACHE_ENTRIES)
-        idx = 0;
+    ASSERT(lock_held_by_current_thread(&buffer_cache_lock));
 
-    for (; idx < BUFFER_CACHE_ENTRIES; idx++)
+    if (scan > BC_VICTIM_SCAN)
+        scan = BC_VICTIM_SCAN;
+    for (size_t i = 0; i < scan; i++)
     {
-        lock_acquire(&(buffer_head[idx].lock));
-        if (!buffer_head[idx].valid_bit)
-        {
-            clock_hand = &buffer_head[idx + 1];
-            return &buffer_head[idx];
-        }
-        if (!buffer_head[idx].reference_bit)
-        {
-            clock_hand = &buffer_head[idx + 1];
-            return &buffer_head[idx];
-        }
-        buffer_head[idx].reference_bit = false;
-        lock_release(&(buffer_head[idx].lock));
+        struct buffer_cache_entry *cur = &buffer_head[clock_hand];
 
-        if (idx == BUFFER_CACHE_ENTRIES - 1)
-            idx = 0;
+        clock_hand = (clock_hand + 1) % buffer_cache_entries;
+        if (cur->busy || cur->reader_cnt > 0)
+            continue;
+        if (!cur->valid_bit || !cur->reference_bit)
+            return cur;
+        cur->reference_bit = false;
+        if (unheld == NULL)
+            unheld = cur;
     }
+    return unheld;
 }
 
+/* Writes P_FLUSH_ENTRY back to disk if it is dirty.  The caller
+   must hold the entry, shared or exclusive. */
 void bc_flush_entry(struct buffer_cache_entry *p_flush_entry)
 {
+    ASSERT(p_flush_entry->busy || p_flush_entry->reader_cnt > 0);
+
     if (!p_flush_entry->valid_bit)
         return;
     if (!p_flush_entry->dirty_bit)
@@ -135,12 +381,153 @@ void bc_flush_entry(struct buffer_cache_entry *p_flush_entry)
     block_write(fs_device, p_flush_entry->disk_sector, p_flush_entry->buffer);
 }
 
+/* Writes back every dirty entry.  Takes each entry exclusively,
+   which also waits out any fill or write-behind still in flight
+   on it. */
 void bc_flush_all_entries(void)
 {
-    for (int i = 0; i < BUFFER_CACHE_ENTRIES; i++)
+    for (size_t i = 0; i < buffer_cache_entries; i++)
+    {
+        struct buffer_cache_entry *cur = &buffer_head[i];
+
+        lock_acquire(&buffer_cache_lock);
+        while (cur->busy || cur->reader_cnt > 0)
+            cond_wait(&cur->released, &buffer_cache_lock);
+        cur->busy = true;
+        lock_release(&buffer_cache_lock);
+
+        bc_flush_entry(cur);
+        bc_put_entry(cur, BC_EXCLUSIVE);
+    }
+}
+
+/* Asks the read-ahead thread to bring SECTOR into the cache.
+   Does not wait for the read, and silently drops the request if
+   too many are already pending. */
+void bc_read_ahead(block_sector_t sector)
+{
+    bool queued = false;
+
+    lock_acquire(&read_ahead_lock);
+    if (read_ahead_tail - read_ahead_head < BC_READ_AHEAD_QUEUE)
     {
-        lock_acquire(&(buffer_head[i].lock));
-        bc_flush_entry(&buffer_head[i]);
-        lock_release(&(buffer_head[i].lock));
+        read_ahead_queue[read_ahead_tail++ % BC_READ_AHEAD_QUEUE] = sector;
+        queued = true;
     }
+    lock_release(&read_ahead_lock);
+
+    if (queued)
+        sema_up(&read_ahead_cnt);
+}
+
+/* Read-ahead thread.  Starts reading queued sectors into the
+   cache so that the reader that asked for them finds them cached,
+   or at least already on their way.  Consecutive sectors are
+   merged into one transfer by the block layer. */
+static void
+bc_read_ahead_worker(void *aux UNUSED)
+{
+    for (;;)
+    {
+        block_sector_t sector;
+
+        sema_down(&read_ahead_cnt);
+        lock_acquire(&read_ahead_lock);
+        sector = read_ahead_queue[read_ahead_head++ % BC_READ_AHEAD_QUEUE];
+        lock_release(&read_ahead_lock);
+
+        if (!bc_cached(sector))
+            bc_get_entry(sector, BC_EXCLUSIVE, BC_FILL_ASYNC);
+    }
+}
+
+/* Write-behind thread.  Periodically writes dirty entries back
+   so that bc_select_victim() usually finds clean victims and a
+   crash loses at most BC_FLUSH_INTERVAL ticks of writes. */
+static void
+bc_flusher(void *aux UNUSED)
+{
+    for (;;)
+    {
+        timer_sleep(BC_FLUSH_INTERVAL);
+        bc_write_behind();
+    }
+}
+
+/* Writes every dirty entry back to disk.  All of the writes are
+   queued at once, so the block layer sees the whole pass and can
+   merge adjacent sectors into single transfers. */
+static void
+bc_write_behind(void)
+{
+    size_t cnt = 0;
+    size_t held = 0;
+
+    /* Unlocked snapshot; each sector is looked up again before
+       being written. */
+    for (size_t i = 0; i < buffer_cache_entries; i++)
+    {
+        struct buffer_cache_entry *cur = &buffer_head[i];
+        if (cur->valid_bit && cur->dirty_bit)
+            flush_sectors[cnt++] = cur->disk_sector;
+    }
+    qsort(flush_sectors, cnt, sizeof *flush_sectors, sector_compare);
+
+    for (size_t i = 0; i < cnt; i++)
+    {
+        struct buffer_cache_entry *cur = bc_get_entry(flush_sectors[i], BC_SHARED, BC_NO_FILL);
+        if (cur == NULL)
+            continue;
+        if (!cur->dirty_bit)
+        {
+            bc_put_entry(cur, BC_SHARED);
+            continue;
+        }
+        cur->dirty_bit = false;
+        block_request_init(&cur->io, true, cur->disk_sector, 1, cur->buffer);
+        block_submit(fs_device, &cur->io);
+        flush_entries[held++] = cur;
+    }
+
+    for (size_t i = 0; i < held; i++)
+    {
+        block_wait(&flush_entries[i]->io);
+        bc_put_entry(flush_entries[i], BC_SHARED);
+    }
+}
+
+/* Orders sector numbers A and B. */
+static int
+sector_compare(const void *a_, const void *b_)
+{
+    const block_sector_t *a = a_;
+    const block_sector_t *b = b_;
+
+    return *a < *b ? -1 : *a > *b;
+}
+
+/* Prints buffer cache statistics. */
+void bc_print_stats(void)
+{
+    printf("Buffer cache: %zu sectors, %llu hits, %llu misses\n",
+           buffer_cache_entries, hit_cnt, miss_cnt);
+}
+
+/* Returns true if SECTOR is cached, without holding its entry. */
+static bool
+bc_cached(block_sector_t sector)
+{
+    bool cached;
+
+    lock_acquire(&buffer_cache_lock);
+    cached = bc_lookup(sector) != NULL;
+    lock_release(&buffer_cache_lock);
+    return cached;
+}
+
+/* Returns the index bucket for SECTOR. */
+static struct list *
+index_bucket(block_sector_t sector)
+{
+    return &buffer_index[hash_int(sector) & (bucket_cnt - 1)];
 }
@@ -1,22 +1,43 @@
+#ifndef FILESYS_BUFFER_CACHE_H
+#define FILESYS_BUFFER_CACHE_H
+
+#include <list.h>
+#include "devices/block.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/synch.h"
 
+/* Number of sectors cached if -bc is not given. */
+#define BUFFER_CACHE_DEFAULT_ENTRIES 64
+
+extern size_t buffer_cache_entries;
+
 struct buffer_cache_entry
 {
     bool dirty_bit;
     bool valid_bit;
     bool reference_bit;
     block_sector_t disk_sector;
-    struct lock lock;
-    uint8_t buffer[BLOCK_SECTOR_SIZE];
+    struct list_elem index_elem; /* Element in a sector index bucket. */
+
+    /* See the synchronization comment in buffer_cache.c. */
+    bool busy;              /* Held exclusively? */
+    int reader_cnt;         /* Number of shared holders. */
+    struct condition released; /* Signaled when the entry is released. */
+
+    uint8_t *buffer;        /* BLOCK_SECTOR_SIZE bytes of data. */
+    struct block_request io; /* Read-ahead fill or write-behind in flight. */
 };
 
 void bc_init(void);
 void bc_term(void);
 bool bc_read(block_sector_t, void *, off_t, int, int);
 bool bc_write(block_sector_t, void *, off_t, int, int);
+void bc_read_ahead(block_sector_t);
 struct buffer_cache_entry *bc_lookup(block_sector_t);
 struct buffer_cache_entry *bc_select_victim(void);
 void bc_flush_entry(struct buffer_cache_entry *);
-void bc_flush_all_entries(void);
\ No newline at end of file
+void bc_flush_all_entries(void);
+void bc_print_stats(void);
+
+#endif /* filesys/buffer_cache.h */
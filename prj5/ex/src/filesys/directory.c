@@ -1,12 +1,28 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include <round.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
-/* A directory. */
+/* A directory.
+
+   A directory is a linear hash table stored in the directory's
+   file.  The first sector holds a `struct dir_header'.  Each
+   following sector is a bucket of DIR_BUCKET_ENTRIES entries, so
+   finding a name reads the header and a single bucket no matter
+   how many entries the directory has.
+
+   The table starts with BASE_CNT buckets.  When a bucket fills
+   up, or the table as a whole gets too full, bucket SPLIT is
+   split: its entries are divided between it and a new bucket
+   appended to the end of the file, and SPLIT advances.  Once
+   every bucket of the current round has been split, LEVEL is
+   incremented and SPLIT starts over at 0.  See bucket_of(). */
 struct dir 
   {
     struct inode *inode;                /* Backing store. */
@@ -21,12 +37,179 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Identifies a directory header. */
+#define DIR_MAGIC 0x48524944
+
+/* Entries per bucket, one bucket per sector. */
+#define DIR_BUCKET_ENTRIES (BLOCK_SECTOR_SIZE / sizeof (struct dir_entry))
+
+/* Split a bucket whenever the table is more than this many
+   percent full, to keep buckets from overflowing. */
+#define DIR_MAX_LOAD 75
+
+/* On-disk directory header, at offset 0 of the directory file. */
+struct dir_header
+  {
+    unsigned magic;                     /* DIR_MAGIC. */
+    uint32_t base_cnt;                  /* Number of buckets at creation. */
+    uint32_t level;                     /* Number of completed rounds. */
+    uint32_t split;                     /* Next bucket to split. */
+    uint32_t entry_cnt;                 /* Number of entries in use. */
+  };
+
+/* One bucket of directory entries. */
+struct dir_bucket
+  {
+    struct dir_entry entries[DIR_BUCKET_ENTRIES];
+  };
+
+/* Recently looked up names, indexed by a hash of the directory's
+   sector and the name.  A hit skips reading the directory. */
+#define NAME_CACHE_SIZE 64
+
+struct name_cache_entry
+  {
+    bool valid;                         /* In use? */
+    block_sector_t dir_sector;          /* Directory inode sector. */
+    block_sector_t inode_sector;        /* Entry's inode sector. */
+    char name[NAME_MAX + 1];            /* Entry's name. */
+  };
+
+static struct name_cache_entry name_cache[NAME_CACHE_SIZE];
+
+/* Serializes all directory operations and protects the name
+   cache.  Splitting moves entries between buckets, so lookups
+   must not run concurrently with additions. */
+static struct lock dir_lock;
+
+/* Initializes the directory module. */
+void
+dir_init (void)
+{
+  lock_init (&dir_lock);
+}
+
+/* Returns the byte offset of bucket IDX in a directory file. */
+static off_t
+bucket_ofs (size_t idx)
+{
+  return (off_t) (idx + 1) * BLOCK_SECTOR_SIZE;
+}
+
+/* Returns the number of buckets in the table described by H. */
+static size_t
+bucket_cnt (const struct dir_header *h)
+{
+  return ((size_t) h->base_cnt << h->level) + h->split;
+}
+
+/* Returns the bucket that a name with hash HASH belongs in,
+   according to header H.  Buckets below SPLIT have already been
+   split in the current round and use twice as many buckets. */
+static size_t
+bucket_of (const struct dir_header *h, unsigned hash)
+{
+  size_t round_cnt = (size_t) h->base_cnt << h->level;
+  size_t idx = hash % round_cnt;
+
+  if (idx < h->split)
+    idx = hash % (round_cnt * 2);
+  return idx;
+}
+
+/* Reads DIR's header into *H.  Returns true if successful. */
+static bool
+read_header (const struct dir *dir, struct dir_header *h)
+{
+  return (inode_read_at (dir->inode, h, sizeof *h, 0) == sizeof *h
+          && h->magic == DIR_MAGIC);
+}
+
+/* Writes *H as DIR's header.  Returns true if successful. */
+static bool
+write_header (struct dir *dir, const struct dir_header *h)
+{
+  return inode_write_at (dir->inode, h, sizeof *h, 0) == sizeof *h;
+}
+
+/* Reads bucket IDX of DIR into *B.  Returns true if successful. */
+static bool
+read_bucket (const struct dir *dir, size_t idx, struct dir_bucket *b)
+{
+  return (inode_read_at (dir->inode, b, sizeof *b, bucket_ofs (idx))
+          == sizeof *b);
+}
+
+/* Writes *B as bucket IDX of DIR, extending the directory if
+   necessary.  Returns true if successful. */
+static bool
+write_bucket (struct dir *dir, size_t idx, const struct dir_bucket *b)
+{
+  return (inode_write_at (dir->inode, b, sizeof *b, bucket_ofs (idx))
+          == sizeof *b);
+}
+
+/* Returns the name cache slot for NAME in the directory whose
+   inode is in DIR_SECTOR. */
+static struct name_cache_entry *
+name_cache_slot (block_sector_t dir_sector, const char *name)
+{
+  unsigned hash = hash_string (name) ^ hash_int (dir_sector);
+  return &name_cache[hash % NAME_CACHE_SIZE];
+}
+
+/* Remembers that NAME in the directory in DIR_SECTOR refers to
+   the inode in INODE_SECTOR. */
+static void
+name_cache_insert (block_sector_t dir_sector, const char *name,
+                   block_sector_t inode_sector)
+{
+  struct name_cache_entry *nc = name_cache_slot (dir_sector, name);
+
+  nc->valid = true;
+  nc->dir_sector = dir_sector;
+  nc->inode_sector = inode_sector;
+  strlcpy (nc->name, name, sizeof nc->name);
+}
+
+/* Returns the cache entry for NAME in the directory in
+   DIR_SECTOR, or a null pointer if it is not cached. */
+static struct name_cache_entry *
+name_cache_find (block_sector_t dir_sector, const char *name)
+{
+  struct name_cache_entry *nc = name_cache_slot (dir_sector, name);
+
+  if (nc->valid && nc->dir_sector == dir_sector && !strcmp (nc->name, name))
+    return nc;
+  return NULL;
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir_header h;
+  struct inode *inode;
+  bool success;
+
+  h.magic = DIR_MAGIC;
+  h.base_cnt = DIV_ROUND_UP (entry_cnt, DIR_BUCKET_ENTRIES);
+  if (h.base_cnt == 0)
+    h.base_cnt = 1;
+  h.level = 0;
+  h.split = 0;
+  h.entry_cnt = 0;
+
+  /* The buckets start out zeroed, that is, empty. */
+  if (!inode_create (sector, bucket_ofs (h.base_cnt)))
+    return false;
+  inode = inode_open (sector);
+  if (inode == NULL)
+    return false;
+  success = inode_write_at (inode, &h, sizeof h, 0) == sizeof h;
+  inode_close (inode);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -83,32 +266,100 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
-/* Searches DIR for a file with the given NAME.
-   If successful, returns true, sets *EP to the directory entry
-   if EP is non-null, and sets *OFSP to the byte offset of the
-   directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+/* Searches bucket B for NAME.  Returns the entry's index within
+   the bucket, or -1 if NAME is not present. */
+static int
+find_in_bucket (const struct dir_bucket *b, const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < DIR_BUCKET_ENTRIES; i++)
+    if (b->entries[i].in_use && !strcmp (name, b->entries[i].name))
+      return i;
+  return -1;
+}
+
+/* Returns the index of a free entry in bucket B, or -1 if B is
+   full. */
+static int
+find_free_in_bucket (const struct dir_bucket *b)
+{
+  size_t i;
+
+  for (i = 0; i < DIR_BUCKET_ENTRIES; i++)
+    if (!b->entries[i].in_use)
+      return i;
+  return -1;
+}
+
+/* Searches DIR, whose header is H, for a file with the given
+   NAME.  Reads the bucket NAME belongs in into *B.
+   If successful, returns true and sets *IDXP to the bucket's
+   index and *SLOTP to the entry's index within it.
+   Otherwise, returns false and sets *IDXP only. */
 static bool
-lookup (const struct dir *dir, const char *name,
-        struct dir_entry *ep, off_t *ofsp) 
+lookup (const struct dir *dir, const struct dir_header *h,
+        const char *name, struct dir_bucket *b, size_t *idxp, int *slotp) 
 {
-  struct dir_entry e;
-  size_t ofs;
-  
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
-      }
-  return false;
+  *idxp = bucket_of (h, hash_string (name));
+  if (!read_bucket (dir, *idxp, b))
+    return false;
+  *slotp = find_in_bucket (b, name);
+  return *slotp >= 0;
+}
+
+/* Splits the next bucket of DIR, whose header is H, into itself
+   and a new bucket at the end of the table, and updates H to
+   match.  OLD is used as a buffer for the bucket being split.
+   Returns true if successful, false if the directory could not
+   be extended, in which case nothing changes. */
+static bool
+split_bucket (struct dir *dir, struct dir_header *h, struct dir_bucket *old)
+{
+  struct dir_header new_h = *h;
+  struct dir_bucket *new;
+  size_t old_idx = h->split;
+  size_t new_idx = bucket_cnt (h);
+  size_t i, j;
+  bool success = false;
+
+  new = calloc (1, sizeof *new);
+  if (new == NULL || !read_bucket (dir, old_idx, old))
+    goto done;
+
+  new_h.split++;
+  if (new_h.split == new_h.base_cnt << new_h.level)
+    {
+      new_h.level++;
+      new_h.split = 0;
+    }
+
+  /* Move the entries that now hash to the new bucket. */
+  for (i = j = 0; i < DIR_BUCKET_ENTRIES; i++)
+    {
+      struct dir_entry *e = &old->entries[i];
+      if (e->in_use && bucket_of (&new_h, hash_string (e->name)) == new_idx)
+        {
+          new->entries[j++] = *e;
+          e->in_use = false;
+        }
+    }
+
+  /* Write the new bucket first, so that running out of disk space
+     leaves the old bucket intact. */
+  if (!write_bucket (dir, new_idx, new)
+      || !write_bucket (dir, old_idx, old)
+      || !write_header (dir, &new_h))
+    goto done;
+  *h = new_h;
+  success = true;
+
+ done:
+  free (new);
+  return success;
 }
 
 /* Searches DIR for a file with the given NAME
@@ -119,15 +370,35 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
-  struct dir_entry e;
+  block_sector_t dir_sector;
+  struct name_cache_entry *nc;
+  struct dir_header h;
+  struct dir_bucket *b;
+  size_t idx;
+  int slot;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+  *inode = NULL;
+  dir_sector = inode_get_inumber (dir->inode);
+  lock_acquire (&dir_lock);
+  nc = name_cache_find (dir_sector, name);
+  if (nc != NULL)
+    *inode = inode_open (nc->inode_sector);
   else
-    *inode = NULL;
+    {
+      b = malloc (sizeof *b);
+      if (b != NULL && read_header (dir, &h)
+          && lookup (dir, &h, name, b, &idx, &slot))
+        {
+          block_sector_t inode_sector = b->entries[slot].inode_sector;
+          name_cache_insert (dir_sector, name, inode_sector);
+          *inode = inode_open (inode_sector);
+        }
+      free (b);
+    }
+  lock_release (&dir_lock);
 
   return *inode != NULL;
 }
@@ -136,13 +407,16 @@ dir_lookup (const struct dir *dir, const char *name,
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
    Returns true if successful, false on failure.
-   Fails if NAME is invalid (i.e. too long) or a disk or memory
-   error occurs. */
+   Fails if NAME is invalid (i.e. too long), if too many names
+   share NAME's hash, or if a disk or memory error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
-  struct dir_entry e;
-  off_t ofs;
+  struct dir_header h;
+  struct dir_bucket *b;
+  struct dir_entry *e;
+  size_t idx, split_max;
+  int slot;
   bool success = false;
 
   ASSERT (dir != NULL);
@@ -152,29 +426,48 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+  b = malloc (sizeof *b);
+  if (b == NULL)
+    return false;
+  lock_acquire (&dir_lock);
+  if (!read_header (dir, &h))
+    goto done;
+
+  /* Keep the table from getting too full. */
+  if ((h.entry_cnt + 1) * 100
+      > bucket_cnt (&h) * DIR_BUCKET_ENTRIES * DIR_MAX_LOAD)
+    split_bucket (dir, &h, b);
+
   /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  if (lookup (dir, &h, name, b, &idx, &slot))
     goto done;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+  /* Split until NAME's bucket has a free slot.  Each split moves
+     the table a step closer to splitting NAME's bucket, which
+     takes at most one round.  Names whose hashes are all equal
+     never separate, so give up after the rest of this round and
+     one more. */
+  split_max = (size_t) h.base_cnt << (h.level + 1);
+  while ((slot = find_free_in_bucket (b)) < 0)
+    if (split_max-- == 0
+        || !split_bucket (dir, &h, b)
+        || !read_bucket (dir, idx = bucket_of (&h, hash_string (name)), b))
+      goto done;
 
   /* Write slot. */
-  e.in_use = true;
-  strlcpy (e.name, name, sizeof e.name);
-  e.inode_sector = inode_sector;
-  success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  e = &b->entries[slot];
+  e->in_use = true;
+  strlcpy (e->name, name, sizeof e->name);
+  e->inode_sector = inode_sector;
+  if (!write_bucket (dir, idx, b))
+    goto done;
+  h.entry_cnt++;
+  success = write_header (dir, &h);
+  name_cache_insert (inode_get_inumber (dir->inode), name, inode_sector);
 
  done:
+  lock_release (&dir_lock);
+  free (b);
   return success;
 }
 
@@ -184,53 +477,79 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
-  struct dir_entry e;
+  block_sector_t dir_sector;
+  struct name_cache_entry *nc;
+  struct dir_header h;
+  struct dir_bucket *b;
+  struct dir_entry *e;
   struct inode *inode = NULL;
   bool success = false;
-  off_t ofs;
+  size_t idx;
+  int slot;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  b = malloc (sizeof *b);
+  if (b == NULL)
+    return false;
+  lock_acquire (&dir_lock);
+
   /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  if (!read_header (dir, &h) || !lookup (dir, &h, name, b, &idx, &slot))
     goto done;
+  e = &b->entries[slot];
 
   /* Open inode. */
-  inode = inode_open (e.inode_sector);
+  inode = inode_open (e->inode_sector);
   if (inode == NULL)
     goto done;
 
   /* Erase directory entry. */
-  e.in_use = false;
-  if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
+  e->in_use = false;
+  if (!write_bucket (dir, idx, b))
     goto done;
+  h.entry_cnt--;
+  write_header (dir, &h);
+
+  dir_sector = inode_get_inumber (dir->inode);
+  nc = name_cache_find (dir_sector, name);
+  if (nc != NULL)
+    nc->valid = false;
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  lock_release (&dir_lock);
   inode_close (inode);
+  free (b);
   return success;
 }
 
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
+   contains no more entries.  DIR's position counts entries
+   across buckets. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  for (;;)
     {
-      dir->pos += sizeof e;
+      size_t idx = dir->pos / DIR_BUCKET_ENTRIES;
+      size_t slot = dir->pos % DIR_BUCKET_ENTRIES;
+      off_t ofs = bucket_ofs (idx) + slot * sizeof e;
+
+      if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+        return false;
+      dir->pos++;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
           return true;
         } 
     }
-  return false;
 }
@@ -83,10 +83,9 @@ off_t file_read_at(struct file *file, void *buffer, off_t size, off_t file_ofs)
 
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
+   Writing past end of file grows the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
    Advances FILE's position by the number of bytes read. */
 off_t file_write(struct file *file, const void *buffer, off_t size)
 {
@@ -97,10 +96,9 @@ off_t file_write(struct file *file, const void *buffer, off_t size)
 
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
+   Writing past end of file grows the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
    The file's current position is unaffected. */
 off_t file_write_at(struct file *file, const void *buffer, off_t size,
                     off_t file_ofs)
@@ -23,6 +23,7 @@ void filesys_init(bool format)
   bc_init();
   inode_init();
   free_map_init();
+  dir_init();
 
   if (format)
     do_format();
@@ -1,42 +1,120 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Number of sectors in an allocation group.  Allocation skips
+   over groups with no free sectors without looking at their
+   bits. */
+#define GROUP_SECTORS 256
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static size_t *group_free_cnt;       /* Free sectors in each group. */
+static size_t group_cnt;             /* Number of groups. */
+static block_sector_t next_fit;      /* Where un-hinted allocations start. */
+static struct lock free_map_lock;    /* Protects all of the above. */
+
+static void count_free_sectors (void);
+static void mark_sectors (block_sector_t, size_t, bool);
+static block_sector_t scan_run (size_t start, size_t end, size_t cnt);
 
 /* Initializes the free map. */
 void
-free_map_init (void) 
+free_map_init (void)
 {
   free_map = bitmap_create (block_size (fs_device));
-  if (free_map == NULL)
+  group_cnt = DIV_ROUND_UP (block_size (fs_device), GROUP_SECTORS);
+  group_free_cnt = malloc (group_cnt * sizeof *group_free_cnt);
+  if (free_map == NULL || group_free_cnt == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
+  lock_init (&free_map_lock);
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  count_free_sectors ();
+  next_fit = 0;
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+   the first into *SECTORP.  Searches onward from where the last
+   such allocation ended.
    Returns true if successful, false if not enough consecutive
    sectors were available or if the free_map file could not be
    written. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  return free_map_allocate_near (cnt, next_fit, sectorp);
+}
+
+/* Allocates CNT consecutive sectors from the free map, as close
+   after sector HINT as possible, and stores the first into
+   *SECTORP.  Passing the sector of a file's inode or last data
+   sector as HINT keeps the file together on disk.
+   Returns true if successful, false if not enough consecutive
+   sectors were available or if the free_map file could not be
+   written. */
+bool
+free_map_allocate_near (size_t cnt, block_sector_t hint,
+                        block_sector_t *sectorp)
+{
+  size_t sector_cnt = bitmap_size (free_map);
+  block_sector_t sector = BITMAP_ERROR;
+  size_t hint_group, i;
+
+  if (cnt == 0 || cnt > sector_cnt)
+    return false;
+  if (hint >= sector_cnt)
+    hint = 0;
+  hint_group = hint / GROUP_SECTORS;
+
+  lock_acquire (&free_map_lock);
+
+  /* Visit the hint's group first, starting at the hint, then the
+     following groups in order, wrapping around and finally
+     looking at the start of the hint's group. */
+  for (i = 0; i <= group_cnt && sector == BITMAP_ERROR; i++)
+    {
+      size_t group = (hint_group + i) % group_cnt;
+      size_t start = group * GROUP_SECTORS;
+      size_t end = start + GROUP_SECTORS;
+
+      if (group_free_cnt[group] == 0)
+        continue;
+      if (i == 0)
+        start = hint;
+      else if (i == group_cnt)
+        end = hint;
+
+      /* A run may start in this group and end in the next. */
+      end += cnt - 1;
+      if (end > sector_cnt)
+        end = sector_cnt;
+      sector = scan_run (start, end, cnt);
+    }
+
+  if (sector != BITMAP_ERROR)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      mark_sectors (sector, cnt, true);
+      if (free_map_file != NULL
+          && !bitmap_write_range (free_map, free_map_file, sector, cnt))
+        {
+          mark_sectors (sector, cnt, false);
+          sector = BITMAP_ERROR;
+        }
     }
   if (sector != BITMAP_ERROR)
-    *sectorp = sector;
+    {
+      next_fit = sector + cnt;
+      *sectorp = sector;
+    }
+
+  lock_release (&free_map_lock);
   return sector != BITMAP_ERROR;
 }
 
@@ -44,25 +122,29 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
-  bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  mark_sectors (sector, cnt, false);
+  if (free_map_file != NULL)
+    bitmap_write_range (free_map, free_map_file, sector, cnt);
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
 void
-free_map_open (void) 
+free_map_open (void)
 {
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  count_free_sectors ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
-free_map_close (void) 
+free_map_close (void)
 {
   file_close (free_map_file);
 }
@@ -70,7 +152,7 @@ free_map_close (void)
 /* Creates a new free map file on disk and writes the free map to
    it. */
 void
-free_map_create (void) 
+free_map_create (void)
 {
   /* Create inode. */
   if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
@@ -83,3 +165,52 @@ free_map_create (void)
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
 }
+
+/* Recomputes the free sector count of every group from the
+   bitmap. */
+static void
+count_free_sectors (void)
+{
+  size_t sector_cnt = bitmap_size (free_map);
+  size_t group;
+
+  for (group = 0; group < group_cnt; group++)
+    {
+      size_t start = group * GROUP_SECTORS;
+      size_t cnt = sector_cnt - start < GROUP_SECTORS
+                   ? sector_cnt - start : GROUP_SECTORS;
+      group_free_cnt[group] = bitmap_count (free_map, start, cnt, false);
+    }
+}
+
+/* Sets the CNT bits starting at SECTOR to USED and updates the
+   group free counts to match. */
+static void
+mark_sectors (block_sector_t sector, size_t cnt, bool used)
+{
+  size_t i;
+
+  bitmap_set_multiple (free_map, sector, cnt, used);
+  for (i = sector; i < sector + cnt; i++)
+    if (used)
+      group_free_cnt[i / GROUP_SECTORS]--;
+    else
+      group_free_cnt[i / GROUP_SECTORS]++;
+}
+
+/* Returns the first sector of the first run of CNT free sectors
+   that starts at or after START and ends at or before END, or
+   BITMAP_ERROR if there is none. */
+static block_sector_t
+scan_run (size_t start, size_t end, size_t cnt)
+{
+  size_t run = 0;
+  size_t i;
+
+  for (i = start; i < end; i++)
+    if (bitmap_test (free_map, i))
+      run = 0;
+    else if (++run == cnt)
+      return i + 1 - cnt;
+  return BITMAP_ERROR;
+}
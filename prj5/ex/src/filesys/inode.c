@@ -2,23 +2,65 @@
 #include "filesys/buffer_cache.h"
 #include <list.h>
 #include <debug.h>
+#include <hash.h>
 #include <round.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Read-ahead window bounds, in sectors.  The window starts at
+   READ_AHEAD_MIN on the first sequential read and doubles on each
+   further sequential read, up to READ_AHEAD_MAX. */
+#define READ_AHEAD_MIN 2
+#define READ_AHEAD_MAX 32
+
+/* Number of buckets in the open inode table. */
+#define OPEN_INODE_BUCKETS 64
+
+/* Number of data sectors mapped directly by an inode, and by
+   one index block. */
+#define DIRECT_BLOCK_ENTRIES 124
+#define INDIRECT_BLOCK_ENTRIES (BLOCK_SECTOR_SIZE / sizeof(block_sector_t))
+
+/* How a data sector is reached from its inode. */
+enum direct_t
+{
+  NORMAL_DIRECT,   /* Through direct_map_table. */
+  INDIRECT,        /* Through the indirect block. */
+  DOUBLE_INDIRECT, /* Through the doubly indirect block. */
+  OUT_LIMIT        /* Past the largest possible file. */
+};
+
+/* Where the map entry for a data sector lives. */
+struct sector_location
+{
+  enum direct_t directness;
+  off_t index1; /* Index in the first table on the path. */
+  off_t index2; /* Index in the second table, for DOUBLE_INDIRECT. */
+};
+
+/* An index block: a table of sector numbers. */
+struct inode_indirect_block
+{
+  block_sector_t map_table[INDIRECT_BLOCK_ENTRIES];
+};
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+   A map entry of 0 means no sector is allocated there, since
+   sector 0 always holds the free map inode. */
 struct inode_disk
 {
-  block_sector_t start; /* First data sector. */
-  off_t length;         /* File size in bytes. */
-  unsigned magic;       /* Magic number. */
-  uint32_t unused[125]; /* Not used. */
+  block_sector_t direct_map_table[DIRECT_BLOCK_ENTRIES]; /* Data sectors. */
+  block_sector_t indirect_block_sec;                     /* Index block. */
+  block_sector_t double_indirect_block_sec;              /* Index of index blocks. */
+  off_t length;                                          /* File size in bytes. */
+  unsigned magic;                                        /* Magic number. */
 };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -32,36 +74,334 @@ bytes_to_sectors(off_t size)
 /* In-memory inode. */
 struct inode
 {
-  struct list_elem elem;  /* Element in inode list. */
+  struct list_elem elem;  /* Element in open inode bucket. */
   block_sector_t sector;  /* Sector number of disk location. */
   int open_cnt;           /* Number of openers. */
   bool removed;           /* True if deleted, false otherwise. */
   int deny_write_cnt;     /* 0: writes ok, >0: deny writes. */
+  struct lock extend_lock; /* Serializes growth of the file. */
   struct inode_disk data; /* Inode content. */
+
+  /* Sequential read detection. */
+  off_t ra_next;          /* Offset the next sequential read starts at. */
+  off_t ra_end;           /* End of the range already read ahead. */
+  int ra_window;          /* Read-ahead window in sectors, 0 if random. */
 };
 
-/* Returns the block device sector that contains byte offset POS
-   within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+/* Finds where the map entry for the sector holding byte offset
+   POS lives and stores it in *SEC_LOC. */
+static void
+locate_byte(off_t pos, struct sector_location *sec_loc)
+{
+  off_t pos_sector = pos / BLOCK_SECTOR_SIZE;
+
+  if (pos_sector < DIRECT_BLOCK_ENTRIES)
+  {
+    sec_loc->directness = NORMAL_DIRECT;
+    sec_loc->index1 = pos_sector;
+    return;
+  }
+  pos_sector -= DIRECT_BLOCK_ENTRIES;
+
+  if (pos_sector < (off_t)INDIRECT_BLOCK_ENTRIES)
+  {
+    sec_loc->directness = INDIRECT;
+    sec_loc->index1 = pos_sector;
+    return;
+  }
+  pos_sector -= INDIRECT_BLOCK_ENTRIES;
+
+  if (pos_sector < (off_t)(INDIRECT_BLOCK_ENTRIES * INDIRECT_BLOCK_ENTRIES))
+  {
+    sec_loc->directness = DOUBLE_INDIRECT;
+    sec_loc->index1 = pos_sector / INDIRECT_BLOCK_ENTRIES;
+    sec_loc->index2 = pos_sector % INDIRECT_BLOCK_ENTRIES;
+    return;
+  }
+
+  sec_loc->directness = OUT_LIMIT;
+}
+
+/* Returns the byte offset of entry INDEX in an index block. */
+static inline off_t
+map_table_offset(int index)
+{
+  return index * sizeof(block_sector_t);
+}
+
+/* Returns entry INDEX of index block TABLE_SECTOR, read through
+   the buffer cache so that hot index blocks stay in memory. */
 static block_sector_t
-byte_to_sector(const struct inode *inode, off_t pos)
+read_map_entry(block_sector_t table_sector, int index)
 {
-  ASSERT(inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
+  block_sector_t sector;
+
+  bc_read(table_sector, &sector, 0, sizeof sector, map_table_offset(index));
+  return sector;
+}
+
+/* Sets entry INDEX of index block TABLE_SECTOR to SECTOR. */
+static void
+write_map_entry(block_sector_t table_sector, int index, block_sector_t sector)
+{
+  bc_write(table_sector, &sector, 0, sizeof sector, map_table_offset(index));
+}
+
+/* Allocates one sector as close after HINT as possible, fills it
+   with zeros and stores its number in *SECTORP.  Returns true if
+   successful, false if the disk is full. */
+static bool
+allocate_zeroed_sector(block_sector_t hint, block_sector_t *sectorp)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  if (!free_map_allocate_near(1, hint, sectorp))
+    return false;
+  bc_write(*sectorp, zeros, 0, BLOCK_SECTOR_SIZE, 0);
+  return true;
+}
+
+/* Returns the data sector that contains byte offset POS within
+   DISK_INODE.
+   Returns -1 if DISK_INODE does not contain data for a byte at
+   offset POS. */
+static block_sector_t
+byte_to_sector(const struct inode_disk *disk_inode, off_t pos)
+{
+  struct sector_location sec_loc;
+  block_sector_t table_sector;
+
+  ASSERT(disk_inode != NULL);
+  if (pos >= disk_inode->length)
     return -1;
+
+  locate_byte(pos, &sec_loc);
+  switch (sec_loc.directness)
+  {
+  case NORMAL_DIRECT:
+    return disk_inode->direct_map_table[sec_loc.index1];
+  case INDIRECT:
+    return read_map_entry(disk_inode->indirect_block_sec, sec_loc.index1);
+  case DOUBLE_INDIRECT:
+    table_sector = read_map_entry(disk_inode->double_indirect_block_sec,
+                                  sec_loc.index1);
+    return read_map_entry(table_sector, sec_loc.index2);
+  default:
+    return -1;
+  }
+}
+
+/* Records NEW_SECTOR as the data sector at SEC_LOC in DISK_INODE,
+   allocating index blocks next to it along the way as needed.
+   Returns true if successful, false if the disk is full. */
+static bool
+register_sector(struct inode_disk *disk_inode, block_sector_t new_sector,
+                struct sector_location sec_loc)
+{
+  block_sector_t table_sector;
+
+  switch (sec_loc.directness)
+  {
+  case NORMAL_DIRECT:
+    disk_inode->direct_map_table[sec_loc.index1] = new_sector;
+    return true;
+
+  case INDIRECT:
+    if (disk_inode->indirect_block_sec == 0
+        && !allocate_zeroed_sector(new_sector,
+                                   &disk_inode->indirect_block_sec))
+      return false;
+    write_map_entry(disk_inode->indirect_block_sec, sec_loc.index1, new_sector);
+    return true;
+
+  case DOUBLE_INDIRECT:
+    if (disk_inode->double_indirect_block_sec == 0
+        && !allocate_zeroed_sector(new_sector,
+                                   &disk_inode->double_indirect_block_sec))
+      return false;
+    table_sector = read_map_entry(disk_inode->double_indirect_block_sec,
+                                  sec_loc.index1);
+    if (table_sector == 0)
+    {
+      if (!allocate_zeroed_sector(new_sector, &table_sector))
+        return false;
+      write_map_entry(disk_inode->double_indirect_block_sec, sec_loc.index1,
+                      table_sector);
+    }
+    write_map_entry(table_sector, sec_loc.index2, new_sector);
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+/* Clears the map entry at SEC_LOC in DISK_INODE and returns the
+   data sector it named, or 0 if there was none.  Index blocks on
+   the way stay allocated; they are freed with the inode. */
+static block_sector_t
+unregister_sector(struct inode_disk *disk_inode, struct sector_location sec_loc)
+{
+  block_sector_t table_sector = 0;
+  block_sector_t sector;
+  int index = sec_loc.index1;
+
+  switch (sec_loc.directness)
+  {
+  case NORMAL_DIRECT:
+    sector = disk_inode->direct_map_table[sec_loc.index1];
+    disk_inode->direct_map_table[sec_loc.index1] = 0;
+    return sector;
+
+  case INDIRECT:
+    table_sector = disk_inode->indirect_block_sec;
+    break;
+
+  case DOUBLE_INDIRECT:
+    if (disk_inode->double_indirect_block_sec != 0)
+      table_sector = read_map_entry(disk_inode->double_indirect_block_sec,
+                                    sec_loc.index1);
+    index = sec_loc.index2;
+    break;
+
+  default:
+    return 0;
+  }
+  if (table_sector == 0)
+    return 0;
+  sector = read_map_entry(table_sector, index);
+  write_map_entry(table_sector, index, 0);
+  return sector;
+}
+
+/* Allocates zeroed data sectors in DISK_INODE for every byte
+   from START_POS up to END_POS, which must lie past the current
+   end of file, and then sets the file length to END_POS.  New
+   sectors are placed after the file's last sector, or after its
+   inode at INODE_SECTOR if it has none, so that files stay
+   contiguous on disk.
+   Returns true if successful.  On failure the length is left
+   alone and the sectors this call added are released again, so
+   that a later extension can reuse their map entries. */
+static bool
+inode_update_file_length(struct inode_disk *disk_inode,
+                         block_sector_t inode_sector, off_t start_pos,
+                         off_t end_pos)
+{
+  block_sector_t hint, sector;
+  off_t first = ROUND_UP(start_pos, BLOCK_SECTOR_SIZE);
+  off_t pos;
+
+  ASSERT(start_pos == disk_inode->length);
+
+  hint = start_pos > 0 ? byte_to_sector(disk_inode, start_pos - 1)
+                       : inode_sector;
+
+  /* Sectors up to bytes_to_sectors (START_POS) already exist. */
+  for (pos = first; pos < end_pos; pos += BLOCK_SECTOR_SIZE)
+  {
+    struct sector_location sec_loc;
+
+    locate_byte(pos, &sec_loc);
+    if (sec_loc.directness == OUT_LIMIT
+        || !allocate_zeroed_sector(hint, &sector))
+      goto fail;
+    if (!register_sector(disk_inode, sector, sec_loc))
+    {
+      free_map_release(sector, 1);
+      goto fail;
+    }
+    hint = sector;
+  }
+
+  /* Publish the new length only once every sector it covers is
+     reachable, since readers check the length without locking. */
+  barrier();
+  disk_inode->length = end_pos;
+  return true;
+
+ fail:
+  while (pos > first)
+  {
+    struct sector_location sec_loc;
+
+    pos -= BLOCK_SECTOR_SIZE;
+    locate_byte(pos, &sec_loc);
+    sector = unregister_sector(disk_inode, sec_loc);
+    if (sector != 0)
+      free_map_release(sector, 1);
+  }
+  return false;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Releases the sectors named by index block TABLE_SECTOR, then
+   the block itself.  If DEPTH is 2, the entries are index blocks
+   and are released recursively. */
+static void
+free_map_table(block_sector_t table_sector, int depth)
+{
+  struct inode_indirect_block *block;
+  size_t i;
+
+  if (table_sector == 0)
+    return;
+
+  block = malloc(sizeof *block);
+  if (block != NULL)
+  {
+    bc_read(table_sector, block, 0, BLOCK_SECTOR_SIZE, 0);
+    for (i = 0; i < INDIRECT_BLOCK_ENTRIES; i++)
+      if (depth > 1)
+        free_map_table(block->map_table[i], depth - 1);
+      else if (block->map_table[i] != 0)
+        free_map_release(block->map_table[i], 1);
+    free(block);
+  }
+  free_map_release(table_sector, 1);
+}
+
+/* Releases every data and index sector of DISK_INODE. */
+static void
+free_inode_sectors(struct inode_disk *disk_inode)
+{
+  int i;
+
+  for (i = 0; i < DIRECT_BLOCK_ENTRIES; i++)
+    if (disk_inode->direct_map_table[i] != 0)
+      free_map_release(disk_inode->direct_map_table[i], 1);
+  free_map_table(disk_inode->indirect_block_sec, 1);
+  free_map_table(disk_inode->double_indirect_block_sec, 2);
+}
+
+/* Open inodes, hashed by sector, so that opening a single inode
+   twice returns the same `struct inode'.  Each bucket has its own
+   lock, which also protects the OPEN_CNT of the inodes in it, so
+   opening and closing different files rarely contend. */
+struct open_inode_bucket
+{
+  struct list inodes;     /* List of `struct inode'. */
+  struct lock lock;       /* Protects INODES and their OPEN_CNT. */
+};
+
+static struct open_inode_bucket open_inodes[OPEN_INODE_BUCKETS];
+
+/* Returns the open inode bucket for SECTOR. */
+static struct open_inode_bucket *
+open_inode_bucket(block_sector_t sector)
+{
+  return &open_inodes[hash_int(sector) % OPEN_INODE_BUCKETS];
+}
 
 /* Initializes the inode module. */
 void inode_init(void)
 {
-  list_init(&open_inodes);
+  size_t i;
+
+  for (i = 0; i < OPEN_INODE_BUCKETS; i++)
+  {
+    list_init(&open_inodes[i].inodes);
+    lock_init(&open_inodes[i].lock);
+  }
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -83,24 +423,16 @@ bool inode_create(block_sector_t sector, off_t length)
   disk_inode = calloc(1, sizeof *disk_inode);
   if (disk_inode != NULL)
   {
-    size_t sectors = bytes_to_sectors(length);
-    disk_inode->length = length;
+    disk_inode->length = 0;
     disk_inode->magic = INODE_MAGIC;
-    if (free_map_allocate(sectors, &disk_inode->start))
+    if (inode_update_file_length(disk_inode, sector, 0, length))
     {
       //block_write(fs_device, sector, disk_inode);
       bc_write(sector, disk_inode, 0, BLOCK_SECTOR_SIZE, 0);
-      if (sectors > 0)
-      {
-        static char zeros[BLOCK_SECTOR_SIZE];
-        size_t i;
-
-        for (i = 0; i < sectors; i++)
-          //block_write(fs_device, disk_inode->start + i, zeros);
-          bc_write(disk_inode->start + i, zeros, 0, BLOCK_SECTOR_SIZE, 0);
-      }
       success = true;
     }
+    else
+      free_inode_sectors(disk_inode);
     free(disk_inode);
   }
   return success;
@@ -112,17 +444,21 @@ bool inode_create(block_sector_t sector, off_t length)
 struct inode *
 inode_open(block_sector_t sector)
 {
+  struct open_inode_bucket *bucket = open_inode_bucket(sector);
   struct list_elem *e;
   struct inode *inode;
 
+  lock_acquire(&bucket->lock);
+
   /* Check whether this inode is already open. */
-  for (e = list_begin(&open_inodes); e != list_end(&open_inodes);
+  for (e = list_begin(&bucket->inodes); e != list_end(&bucket->inodes);
        e = list_next(e))
   {
     inode = list_entry(e, struct inode, elem);
     if (inode->sector == sector)
     {
-      inode_reopen(inode);
+      inode->open_cnt++;
+      lock_release(&bucket->lock);
       return inode;
     }
   }
@@ -130,16 +466,24 @@ inode_open(block_sector_t sector)
   /* Allocate memory. */
   inode = malloc(sizeof *inode);
   if (inode == NULL)
+  {
+    lock_release(&bucket->lock);
     return NULL;
+  }
 
-  /* Initialize. */
-  list_push_front(&open_inodes, &inode->elem);
+  /* Initialize.  The bucket stays locked until the inode is read,
+     so that a concurrent opener never sees it half-initialized. */
+  list_push_front(&bucket->inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read(fs_device, inode->sector, &inode->data);
+  lock_init(&inode->extend_lock);
+  inode->ra_next = 0;
+  inode->ra_end = 0;
+  inode->ra_window = 0;
   bc_read(inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE, 0);
+  lock_release(&bucket->lock);
   return inode;
 }
 
@@ -148,7 +492,13 @@ struct inode *
 inode_reopen(struct inode *inode)
 {
   if (inode != NULL)
+  {
+    struct open_inode_bucket *bucket = open_inode_bucket(inode->sector);
+
+    lock_acquire(&bucket->lock);
     inode->open_cnt++;
+    lock_release(&bucket->lock);
+  }
   return inode;
 }
 
@@ -164,22 +514,28 @@ inode_get_inumber(const struct inode *inode)
    If INODE was also a removed inode, frees its blocks. */
 void inode_close(struct inode *inode)
 {
+  struct open_inode_bucket *bucket;
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
-  {
-    /* Remove from inode list and release lock. */
+  bucket = open_inode_bucket(inode->sector);
+  lock_acquire(&bucket->lock);
+  last = --inode->open_cnt == 0;
+  if (last)
     list_remove(&inode->elem);
+  lock_release(&bucket->lock);
 
+  /* Release resources if this was the last opener. */
+  if (last)
+  {
     /* Deallocate blocks if removed. */
     if (inode->removed)
     {
+      free_inode_sectors(&inode->data);
       free_map_release(inode->sector, 1);
-      free_map_release(inode->data.start,
-                       bytes_to_sectors(inode->data.length));
     }
 
     free(inode);
@@ -194,6 +550,42 @@ void inode_remove(struct inode *inode)
   inode->removed = true;
 }
 
+/* Updates INODE's sequential access state for a read of the bytes
+   between START and END, and if the access pattern is sequential
+   queues the sectors in the read-ahead window after END. */
+static void
+read_ahead(struct inode *inode, off_t start, off_t end)
+{
+  off_t pos, limit;
+
+  if (start == inode->ra_next)
+  {
+    inode->ra_window = inode->ra_window == 0 ? READ_AHEAD_MIN : inode->ra_window * 2;
+    if (inode->ra_window > READ_AHEAD_MAX)
+      inode->ra_window = READ_AHEAD_MAX;
+  }
+  else
+  {
+    inode->ra_window = 0;
+    inode->ra_end = 0;
+  }
+  inode->ra_next = end;
+  if (inode->ra_window == 0)
+    return;
+
+  pos = ROUND_UP(end, BLOCK_SECTOR_SIZE);
+  if (pos < inode->ra_end)
+    pos = inode->ra_end;
+  limit = end + inode->ra_window * BLOCK_SECTOR_SIZE;
+  if (limit > inode_length(inode))
+    limit = inode_length(inode);
+
+  for (; pos < limit; pos += BLOCK_SECTOR_SIZE)
+    bc_read_ahead(byte_to_sector(&inode->data, pos));
+  if (limit > inode->ra_end)
+    inode->ra_end = limit;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
@@ -201,12 +593,13 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
+  off_t start = offset;
   uint8_t *bounce = NULL;
 
   while (size > 0)
   {
     /* Disk sector to read, starting byte offset within sector. */
-    block_sector_t sector_idx = byte_to_sector(inode, offset);
+    block_sector_t sector_idx = byte_to_sector(&inode->data, offset);
     int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
     /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -246,14 +639,17 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
   }
   //free(bounce);
 
+  if (bytes_read > 0)
+    read_ahead(inode, start, offset);
+
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Writing past end of file extends the inode, filling any gap
+   with zeros.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up or an error occurs. */
 off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
                      off_t offset)
 {
@@ -264,10 +660,24 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
   if (inode->deny_write_cnt)
     return 0;
 
+  if (offset + size > inode_length(inode))
+  {
+    lock_acquire(&inode->extend_lock);
+    if (offset + size > inode_length(inode))
+    {
+      /* On failure the file keeps its old length and the loop
+         below writes what fits. */
+      inode_update_file_length(&inode->data, inode->sector,
+                               inode->data.length, offset + size);
+      bc_write(inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE, 0);
+    }
+    lock_release(&inode->extend_lock);
+  }
+
   while (size > 0)
   {
     /* Sector to write, starting byte offset within sector. */
-    block_sector_t sector_idx = byte_to_sector(inode, offset);
+    block_sector_t sector_idx = byte_to_sector(&inode->data, offset);
     int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
     /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -19,8 +19,5 @@ off_t inode_write_at(struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write(struct inode *);
 void inode_allow_write(struct inode *);
 off_t inode_length(const struct inode *);
-static bool get_disk_inode(const struct inode *, struct inode_disk *);
-static void locate_byte(off_t, struct sector_location *);
-static inline off_t map_table_offset(int);
 
 #endif /* filesys/inode.h */
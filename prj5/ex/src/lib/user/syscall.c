@@ -190,3 +190,8 @@ int inumber(int fd)
 {
   return syscall1(SYS_INUMBER, fd);
 }
+
+bool block_stats(unsigned idx, struct block_stats *stats)
+{
+  return syscall2(SYS_BLOCK_STATS, idx, stats);
+}
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <block-stats.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -47,4 +48,7 @@ bool readdir(int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir(int fd);
 int inumber(int fd);
 
+/* Diagnostics. */
+bool block_stats(unsigned idx, struct block_stats *);
+
 #endif /* lib/user/syscall.h */
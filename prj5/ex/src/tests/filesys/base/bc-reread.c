@@ -0,0 +1,47 @@
+/* Microbenchmark for the buffer cache lookup path.  Writes a
+   file that fits comfortably in the buffer cache, then re-reads
+   it many times one sector at a time, so that nearly every
+   lookup is a hit.  The test checks the buffer cache's hit and
+   miss counts and reports how many ticks the re-reads took. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (16 * 512)
+#define PASS_CNT 200
+
+static char buf[FILE_SIZE];
+static char sector[512];
+
+void
+test_main (void) 
+{
+  const char *file_name = "cached";
+  size_t ofs;
+  int fd;
+  int pass;
+
+  CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+         "write \"%s\"", file_name);
+
+  msg ("re-read \"%s\" %d times", file_name, PASS_CNT);
+  for (pass = 0; pass < PASS_CNT; pass++)
+    {
+      seek (fd, 0);
+      for (ofs = 0; ofs < sizeof buf; ofs += sizeof sector)
+        {
+          if (read (fd, sector, sizeof sector) != sizeof sector)
+            fail ("read %zu bytes at offset %zu in \"%s\" failed",
+                  sizeof sector, ofs, file_name);
+          compare_bytes (sector, buf + ofs, sizeof sector, ofs, file_name);
+        }
+    }
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(bc-reread) begin
+(bc-reread) create "cached"
+(bc-reread) open "cached"
+(bc-reread) write "cached"
+(bc-reread) re-read "cached" 200 times
+(bc-reread) close "cached"
+(bc-reread) end
+EOF
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($hits, $misses)
+  = map (/^Buffer cache: .*\b(\d+) hits, (\d+) misses$/, @output);
+fail "missing buffer cache statistics" if !defined $misses;
+# 200 passes over 16 sectors, every one of them cached.
+fail "$hits buffer cache hits, expected at least 3200 for the re-reads"
+  if $hits < 3200;
+# Formatting, loading the test and writing the file take a few
+# hundred misses at most; the re-reads take none.
+fail "$misses buffer cache misses for $hits hits" if $misses * 8 > $hits;
+my ($ticks) = map (/^Execution of '.*' took (\d+) ticks\.$/, @output);
+fail "missing tick count" if !defined $ticks;
+pass ("bc-reread: $hits hits, $misses misses in $ticks ticks");
@@ -0,0 +1,40 @@
+/* Reads a file back and checks that the block_stats system call
+   reports the device activity, then lists every device.  Compare
+   the statistics printed at shutdown with the ones seen here. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[4096];
+
+void
+test_main (void) 
+{
+  struct block_stats s;
+  uint64_t total_reads = 0;
+  unsigned idx;
+  int fd;
+
+  CHECK (create ("data", sizeof buf), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  CHECK (read (fd, buf, sizeof buf) == sizeof buf, "read \"data\"");
+  close (fd);
+
+  for (idx = 0; block_stats (idx, &s); idx++)
+    {
+      uint64_t hist_sum = 0;
+      int i;
+
+      for (i = 0; i < BLOCK_LAT_BUCKETS; i++)
+        hist_sum += s.service_hist[i];
+      if (s.read_ops + s.write_ops > 0 && hist_sum == 0)
+        fail ("%s: %llu transfers but empty latency histogram",
+              s.name, s.read_ops + s.write_ops);
+      if (s.read_ops > s.read_cnt || s.write_ops > s.write_cnt)
+        fail ("%s: more transfers than sectors", s.name);
+      total_reads += s.read_cnt;
+    }
+  CHECK (idx > 0, "block_stats lists devices");
+  CHECK (total_reads > 0, "some device was read");
+}
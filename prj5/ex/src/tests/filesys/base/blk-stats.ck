@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(blk-stats) begin
+(blk-stats) create "data"
+(blk-stats) open "data"
+(blk-stats) read "data"
+(blk-stats) block_stats lists devices
+(blk-stats) some device was read
+(blk-stats) end
+EOF
+pass;
@@ -0,0 +1,44 @@
+/* Child process for the par-read tests.
+   Reads the whole test file PASS_CNT times, verifying it each
+   time.  All readers hit the same few cached sectors, so the
+   aggregate rate at which they finish measures how well the
+   buffer cache lets readers of one sector run side by side. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/par-read.h"
+
+static char expected[BUF_SIZE];
+static char buf[BUF_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  int child_idx;
+  int fd;
+  int pass;
+
+  test_name = "child-par-read";
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  random_init (0);
+  random_bytes (expected, sizeof expected);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (pass = 0; pass < PASS_CNT; pass++)
+    {
+      seek (fd, 0);
+      CHECK (read (fd, buf, sizeof buf) == sizeof buf,
+             "read \"%s\"", file_name);
+      compare_bytes (buf, expected, sizeof buf, 0, file_name);
+    }
+  close (fd);
+
+  return child_idx;
+}
@@ -0,0 +1,57 @@
+/* Creates enough files in the root directory to make it split
+   its hash buckets several times, then checks that every file
+   can still be opened, removes every other one, and checks that
+   exactly the removed ones are gone. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 300
+
+void
+test_main (void) 
+{
+  char name[16];
+  int fd;
+  int i;
+
+  msg ("create %d files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "file%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+
+  msg ("open %d files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "file%d", i);
+      if ((fd = open (name)) < 2)
+        fail ("open \"%s\" failed", name);
+      close (fd);
+    }
+
+  msg ("remove every other file");
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      snprintf (name, sizeof name, "file%d", i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+
+  msg ("open %d files again", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "file%d", i);
+      fd = open (name);
+      if (i % 2 == 0 && fd != -1)
+        fail ("open \"%s\" succeeded after remove", name);
+      if (i % 2 == 1 && fd < 2)
+        fail ("open \"%s\" failed", name);
+      if (fd >= 2)
+        close (fd);
+    }
+}
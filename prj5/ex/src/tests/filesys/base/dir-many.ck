@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-many) begin
+(dir-many) create 300 files
+(dir-many) open 300 files
+(dir-many) remove every other file
+(dir-many) open 300 files again
+(dir-many) end
+EOF
+pass;
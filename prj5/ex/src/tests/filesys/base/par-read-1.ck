@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(par-read-1) begin
+(par-read-1) create "hot"
+(par-read-1) open "hot"
+(par-read-1) write "hot"
+(par-read-1) close "hot"
+(par-read-1) exec child 1 of 1: "child-par-read 0"
+(par-read-1) wait for child 1 of 1 returned 0 (expected 0)
+(par-read-1) end
+EOF
+our ($test);
+my ($ticks) = map (/^Execution of '.*' took (\d+) ticks\.$/,
+		   read_text_file ("$test.output"));
+fail "missing tick count" if !defined $ticks;
+# READER_CNT readers each read BUF_SIZE bytes PASS_CNT times.
+my ($bytes) = 1 * 1024 * 256;
+pass (sprintf ("par-read-1: %d bytes in %d ticks, %d bytes per tick",
+	       $bytes, $ticks, $bytes / ($ticks || 1)));
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(par-read-2) begin
+(par-read-2) create "hot"
+(par-read-2) open "hot"
+(par-read-2) write "hot"
+(par-read-2) close "hot"
+(par-read-2) exec child 1 of 2: "child-par-read 0"
+(par-read-2) exec child 2 of 2: "child-par-read 1"
+(par-read-2) wait for child 1 of 2 returned 0 (expected 0)
+(par-read-2) wait for child 2 of 2 returned 1 (expected 1)
+(par-read-2) end
+EOF
+our ($test);
+my ($ticks) = map (/^Execution of '.*' took (\d+) ticks\.$/,
+		   read_text_file ("$test.output"));
+fail "missing tick count" if !defined $ticks;
+# READER_CNT readers each read BUF_SIZE bytes PASS_CNT times.
+my ($bytes) = 2 * 1024 * 256;
+pass (sprintf ("par-read-2: %d bytes in %d ticks, %d bytes per tick",
+	       $bytes, $ticks, $bytes / ($ticks || 1)));
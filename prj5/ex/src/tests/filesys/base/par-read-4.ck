@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(par-read-4) begin
+(par-read-4) create "hot"
+(par-read-4) open "hot"
+(par-read-4) write "hot"
+(par-read-4) close "hot"
+(par-read-4) exec child 1 of 4: "child-par-read 0"
+(par-read-4) exec child 2 of 4: "child-par-read 1"
+(par-read-4) exec child 3 of 4: "child-par-read 2"
+(par-read-4) exec child 4 of 4: "child-par-read 3"
+(par-read-4) wait for child 1 of 4 returned 0 (expected 0)
+(par-read-4) wait for child 2 of 4 returned 1 (expected 1)
+(par-read-4) wait for child 3 of 4 returned 2 (expected 2)
+(par-read-4) wait for child 4 of 4 returned 3 (expected 3)
+(par-read-4) end
+EOF
+our ($test);
+my ($ticks) = map (/^Execution of '.*' took (\d+) ticks\.$/,
+		   read_text_file ("$test.output"));
+fail "missing tick count" if !defined $ticks;
+# READER_CNT readers each read BUF_SIZE bytes PASS_CNT times.
+my ($bytes) = 4 * 1024 * 256;
+pass (sprintf ("par-read-4: %d bytes in %d ticks, %d bytes per tick",
+	       $bytes, $ticks, $bytes / ($ticks || 1)));
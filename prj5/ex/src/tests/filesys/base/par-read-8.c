@@ -0,0 +1,7 @@
+/* Spawns 8 reader processes that repeatedly read the
+   same small file.  Together with the other par-read tests, the
+   read rate the test reports gives aggregate read throughput for
+   1, 2, 4 and 8 concurrent readers. */
+
+#define READER_CNT 8
+#include "tests/filesys/base/par-read.inc"
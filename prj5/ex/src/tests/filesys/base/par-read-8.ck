@@ -0,0 +1,36 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(par-read-8) begin
+(par-read-8) create "hot"
+(par-read-8) open "hot"
+(par-read-8) write "hot"
+(par-read-8) close "hot"
+(par-read-8) exec child 1 of 8: "child-par-read 0"
+(par-read-8) exec child 2 of 8: "child-par-read 1"
+(par-read-8) exec child 3 of 8: "child-par-read 2"
+(par-read-8) exec child 4 of 8: "child-par-read 3"
+(par-read-8) exec child 5 of 8: "child-par-read 4"
+(par-read-8) exec child 6 of 8: "child-par-read 5"
+(par-read-8) exec child 7 of 8: "child-par-read 6"
+(par-read-8) exec child 8 of 8: "child-par-read 7"
+(par-read-8) wait for child 1 of 8 returned 0 (expected 0)
+(par-read-8) wait for child 2 of 8 returned 1 (expected 1)
+(par-read-8) wait for child 3 of 8 returned 2 (expected 2)
+(par-read-8) wait for child 4 of 8 returned 3 (expected 3)
+(par-read-8) wait for child 5 of 8 returned 4 (expected 4)
+(par-read-8) wait for child 6 of 8 returned 5 (expected 5)
+(par-read-8) wait for child 7 of 8 returned 6 (expected 6)
+(par-read-8) wait for child 8 of 8 returned 7 (expected 7)
+(par-read-8) end
+EOF
+our ($test);
+my ($ticks) = map (/^Execution of '.*' took (\d+) ticks\.$/,
+		   read_text_file ("$test.output"));
+fail "missing tick count" if !defined $ticks;
+# READER_CNT readers each read BUF_SIZE bytes PASS_CNT times.
+my ($bytes) = 8 * 1024 * 256;
+pass (sprintf ("par-read-8: %d bytes in %d ticks, %d bytes per tick",
+	       $bytes, $ticks, $bytes / ($ticks || 1)));
@@ -0,0 +1,13 @@
+#ifndef TESTS_FILESYS_BASE_PAR_READ_H
+#define TESTS_FILESYS_BASE_PAR_READ_H
+
+/* A small, hot file, like a directory or inode sector that many
+   processes look at concurrently. */
+#define BUF_SIZE 1024
+
+/* Number of times each reader reads the whole file. */
+#define PASS_CNT 256
+
+static const char file_name[] = "hot";
+
+#endif /* tests/filesys/base/par-read.h */
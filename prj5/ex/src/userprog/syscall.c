@@ -11,6 +11,7 @@
 #include <string.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "devices/block.h"
 
 struct lock file_lock;
 
@@ -131,6 +132,11 @@ syscall_handler(struct intr_frame *f UNUSED)
       exit(-1);
     f->eax = (uint32_t)max_of_four_int((int)sc[1], (int)sc[2], (int)sc[3], (int)sc[4]);
     break;
+  case SYS_BLOCK_STATS:
+    if (!verify_access((uint32_t *)&sc[1], 2))
+      exit(-1);
+    f->eax = (uint32_t)block_stats((unsigned)sc[1], (struct block_stats *)sc[2]);
+    break;
 
   default:
     exit(-1);
@@ -381,6 +387,24 @@ int max_of_four_int(int a, int b, int c, int d)
   return maxi;
 }
 
+/* Copies the statistics of the IDX'th registered block device,
+   counting from 0, into *STATS.  Returns false if there are not
+   that many devices. */
+bool block_stats(unsigned idx, struct block_stats *stats)
+{
+  struct block *block;
+
+  if (stats == NULL || !is_user_vaddr(stats) || !is_user_vaddr((char *)(stats + 1) - 1))
+    exit(-1);
+
+  for (block = block_first(); block != NULL && idx > 0; block = block_next(block))
+    idx--;
+  if (block == NULL)
+    return false;
+  block_get_stats(block, stats);
+  return true;
+}
+
 bool verify_access(uint32_t *args, int argc)
 {
   for (int i = 0; i < argc; i++)